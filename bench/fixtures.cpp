@@ -0,0 +1,185 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "fixtures.h"
+#include "engine/core/math.h"
+#include "vorbis/vorbisenc.h"
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+TW_NAMESPACE_BEGIN
+
+namespace bench {
+
+/// Generate a sample value for the given frame and channel.
+static float signal(const FixtureSpec& spec, int frame, int channel)
+{
+    constexpr float twoPi{ core::math::Constants<float>::twoPi };
+
+    const float t{ (float)frame / (float)spec.sampleRate };
+    const float w{ twoPi * spec.frequency * t };
+    const float decay{ std::exp(-0.5f * t) };
+
+    // A few harmonics, slightly detuned on the right channel
+    const float detune{ channel == 0 ? 1.0f : 1.003f };
+    float x{ std::sin(w * detune) + 0.5f * std::sin(2.0f * w * detune) + 0.25f * std::sin(3.0f * w * detune) };
+
+    return 0.4f * decay * x;
+}
+
+template <typename T>
+static void writeValue(std::ofstream& stream, T value)
+{
+    stream.write((const char*)&value, sizeof(T));
+}
+
+core::Error writeWavFixture(const std::string& path, const FixtureSpec& spec)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return core::Error("Unable to create " + path);
+
+    const uint16_t bytesPerSample{ 2 };
+    const uint16_t blockAlign{ (uint16_t)(spec.numChannels * bytesPerSample) };
+    const uint32_t dataSize{ (uint32_t)spec.numFrames * blockAlign };
+
+    file.write("RIFF", 4);
+    writeValue<uint32_t>(file, 36 + dataSize);
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    writeValue<uint32_t>(file, 16);
+    writeValue<uint16_t>(file, 1); // PCM
+    writeValue<uint16_t>(file, (uint16_t)spec.numChannels);
+    writeValue<uint32_t>(file, (uint32_t)spec.sampleRate);
+    writeValue<uint32_t>(file, (uint32_t)spec.sampleRate * blockAlign);
+    writeValue<uint16_t>(file, blockAlign);
+    writeValue<uint16_t>(file, bytesPerSample * 8);
+
+    file.write("data", 4);
+    writeValue<uint32_t>(file, dataSize);
+
+    std::vector<int16_t> frame((size_t)spec.numChannels);
+
+    for (int i = 0; i < spec.numFrames; ++i) {
+        for (int c = 0; c < spec.numChannels; ++c)
+            frame[c] = (int16_t)std::lrint(core::math::clamp(-1.0f, 1.0f, signal(spec, i, c)) * 32767.0f);
+
+        file.write((const char*)frame.data(), sizeof(int16_t) * frame.size());
+    }
+
+    if (!file.good())
+        return core::Error("Failed to write " + path);
+
+    return {};
+}
+
+core::Error writeOggFixture(const std::string& path, const FixtureSpec& spec)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+
+    if (!file.is_open())
+        return core::Error("Unable to create " + path);
+
+    vorbis_info vi;
+    vorbis_comment vc;
+    vorbis_dsp_state vd;
+    vorbis_block vb;
+    ogg_stream_state os;
+    ogg_page og;
+    ogg_packet op;
+
+    vorbis_info_init(&vi);
+
+    if (vorbis_encode_init_vbr(&vi, spec.numChannels, spec.sampleRate, 0.4f) != 0) {
+        vorbis_info_clear(&vi);
+        return core::Error("Unable to initialize vorbis encoder");
+    }
+
+    vorbis_comment_init(&vc);
+    vorbis_analysis_init(&vd, &vi);
+    vorbis_block_init(&vd, &vb);
+    ogg_stream_init(&os, 0x746e7768);
+
+    auto writePage = [&]() {
+        file.write((const char*)og.header, og.header_len);
+        file.write((const char*)og.body, og.body_len);
+    };
+
+    {
+        ogg_packet header;
+        ogg_packet headerComment;
+        ogg_packet headerCode;
+
+        vorbis_analysis_headerout(&vd, &vc, &header, &headerComment, &headerCode);
+        ogg_stream_packetin(&os, &header);
+        ogg_stream_packetin(&os, &headerComment);
+        ogg_stream_packetin(&os, &headerCode);
+
+        while (ogg_stream_flush(&os, &og) != 0)
+            writePage();
+    }
+
+    constexpr int chunkSize{ 1024 };
+    int frame{ 0 };
+    bool eos{ false };
+
+    while (!eos) {
+        const int n{ std::min(chunkSize, spec.numFrames - frame) };
+
+        if (n > 0) {
+            float** buffer{ vorbis_analysis_buffer(&vd, n) };
+
+            for (int c = 0; c < spec.numChannels; ++c) {
+                for (int i = 0; i < n; ++i)
+                    buffer[c][i] = signal(spec, frame + i, c);
+            }
+
+            vorbis_analysis_wrote(&vd, n);
+            frame += n;
+        } else {
+            // Signal the end of stream
+            vorbis_analysis_wrote(&vd, 0);
+        }
+
+        while (vorbis_analysis_blockout(&vd, &vb) == 1) {
+            vorbis_analysis(&vb, nullptr);
+            vorbis_bitrate_addblock(&vb);
+
+            while (vorbis_bitrate_flushpacket(&vd, &op) != 0) {
+                ogg_stream_packetin(&os, &op);
+
+                while (!eos && ogg_stream_pageout(&os, &og) != 0) {
+                    writePage();
+
+                    if (ogg_page_eos(&og) != 0)
+                        eos = true;
+                }
+            }
+        }
+    }
+
+    ogg_stream_clear(&os);
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+    vorbis_comment_clear(&vc);
+    vorbis_info_clear(&vi);
+
+    if (!file.good())
+        return core::Error("Failed to write " + path);
+
+    return {};
+}
+
+} // namespace bench
+
+TW_NAMESPACE_END
@@ -0,0 +1,42 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "engine/globals.h"
+#include "engine/core/error.h"
+#include <string>
+
+TW_NAMESPACE_BEGIN
+
+namespace bench {
+
+/**
+ * Generated test signal description.
+ */
+struct FixtureSpec
+{
+    int sampleRate  { 44100 };
+    int numChannels { 2 };
+    int numFrames   { 44100 * 4 };
+    float frequency { 220.0f };
+};
+
+/**
+ * Write a 16-bit PCM WAV file with a decaying harmonic tone.
+ */
+core::Error writeWavFixture(const std::string& path, const FixtureSpec& spec);
+
+/**
+ * Write an Ogg Vorbis file with the same signal as @ref writeWavFixture.
+ */
+core::Error writeOggFixture(const std::string& path, const FixtureSpec& spec);
+
+} // namespace bench
+
+TW_NAMESPACE_END
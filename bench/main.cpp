@@ -0,0 +1,366 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+/**
+ * Offline render benchmark.
+ *
+ * This tool drives the engine's audio callback (events processing and
+ * bus rendering) in a tight loop against generated WAV and Ogg Vorbis
+ * fixtures, and reports the per-callback processing cost.
+ *
+ * Usage:
+ *      tonewheel_bench [--block N] [--blocks N] [--sr F] [--preload N] [--threads N] [--cache MB]
+ *                      [--voices N --buses M [--loop] [--fx] [--ogg]]
+ *
+ * When no custom scenario is specified (via --voices) a default set
+ * of scenarios is executed.
+ */
+
+#include "fixtures.h"
+#include "engine/engine.h"
+#include "engine/voice.h"
+#include "engine/sample.h"
+#include "engine/block_cache.h"
+#include "engine/audio_stream.h"
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+TW_USING_NAMESPACE
+
+namespace {
+
+constexpr int numFixtures{ 8 };
+constexpr int fixtureSampleRate{ 44100 };
+constexpr int fixtureNumFrames{ fixtureSampleRate * 4 };
+constexpr int loopBegin{ fixtureSampleRate };
+constexpr int loopEnd{ fixtureSampleRate * 3 };
+
+struct Options
+{
+    int blockSize  { 256 };
+    int numBlocks  { 4000 };
+    float sampleRate { 44100.0f };
+    int preloadSize { 32768 };
+    int numThreads  { 1 };
+    int cacheSize   { (int)(DEFAULT_BLOCK_CACHE_SIZE >> 20) };   ///< Blocks cache size in MB.
+    bool offline    { false };  ///< Render in the non-realtime mode.
+};
+
+struct Scenario
+{
+    std::string name{};
+    int numVoices { 64 };
+    int numBuses  { 4 };
+    bool loop     { false };
+    bool voiceFx  { false };
+    bool ogg      { false };
+};
+
+struct Result
+{
+    double mean { 0.0 };
+    double p50  { 0.0 };
+    double p99  { 0.0 };
+    double max  { 0.0 };
+    double averageVoices { 0.0 };
+    double cacheHitRate  { 0.0 };
+    uint64_t underruns   { 0 };
+};
+
+struct Fixtures
+{
+    std::vector<std::string> wav{};
+    std::vector<std::string> ogg{};
+};
+
+Fixtures generateFixtures()
+{
+    namespace fs = std::filesystem;
+
+    const auto dir{ fs::temp_directory_path() / "tonewheel_bench" };
+    fs::create_directories(dir);
+
+    Fixtures fixtures{};
+
+    for (int i = 0; i < numFixtures; ++i) {
+        bench::FixtureSpec spec{};
+        spec.sampleRate = fixtureSampleRate;
+        spec.numFrames = fixtureNumFrames;
+        spec.frequency = 110.0f * std::pow(2.0f, (float)i / 4.0f);
+
+        const auto wavPath{ (dir / ("fixture_" + std::to_string(i) + ".wav")).string() };
+        const auto oggPath{ (dir / ("fixture_" + std::to_string(i) + ".ogg")).string() };
+
+        if (!fs::exists(wavPath)) {
+            if (auto res{ bench::writeWavFixture(wavPath, spec) }; res.failed()) {
+                std::fprintf(stderr, "%s\n", res.message().c_str());
+                std::exit(1);
+            }
+        }
+
+        if (!fs::exists(oggPath)) {
+            if (auto res{ bench::writeOggFixture(oggPath, spec) }; res.failed()) {
+                std::fprintf(stderr, "%s\n", res.message().c_str());
+                std::exit(1);
+            }
+        }
+
+        fixtures.wav.push_back(wavPath);
+        fixtures.ogg.push_back(oggPath);
+    }
+
+    return fixtures;
+}
+
+void waitForPreload()
+{
+    constexpr auto timeout{ std::chrono::seconds(30) };
+
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    const auto start{ std::chrono::steady_clock::now() };
+
+    while (samplePool.getNumPreloadedSamples() < samplePool.getNumSamples()) {
+        if (std::chrono::steady_clock::now() - start > timeout) {
+            std::fprintf(stderr, "Timed out waiting for the samples preload\n");
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    const auto idx{ (size_t)std::min((double)sorted.size() - 1.0, p * (double)(sorted.size() - 1)) };
+    return sorted[idx];
+}
+
+Result runScenario(const Scenario& scenario, const Options& options, const Fixtures& fixtures)
+{
+    auto* g{ GlobalEngine::getInstance() };
+    const auto& paths{ scenario.ogg ? fixtures.ogg : fixtures.wav };
+
+    Engine engine(scenario.numBuses);
+
+    std::vector<int> sampleIds{};
+
+    for (const auto& path : paths)
+        sampleIds.push_back(engine.addSample(path));
+
+    g->getSamplePool().preload(options.preloadSize);
+    waitForPreload();
+
+    engine.prepareToPlay(options.sampleRate, options.blockSize);
+    engine.getAudioBusPool().setNumRenderThreads(options.numThreads);
+    engine.setNonRealtime(options.offline);
+
+    g->getBlockCache().clear();
+    g->getBlockCache().resetStats();
+    g->getAudioStreamPool().resetUnderruns();
+
+    core::AudioBuffer<float> output(MIX_BUFFER_NUM_CHANNELS, options.blockSize);
+
+    std::vector<double> timings{};
+    timings.reserve((size_t)options.numBlocks);
+
+    double voicesAccumulator{ 0.0 };
+    int triggerCounter{ 0 };
+
+    for (int block = 0; block < options.numBlocks; ++block) {
+        // Keep the requested polyphony by retriggering finished voices.
+        // This happens outside of the measured section, since the triggers
+        // are normally sent from a non-audio thread.
+        const int activeVoices{ g->getVoicePool().getNumActiveVoices() };
+
+        for (int i = activeVoices; i < scenario.numVoices; ++i) {
+            Engine::Trigger trigger{};
+            trigger.sampleId = sampleIds[(size_t)triggerCounter % sampleIds.size()];
+            trigger.busNumber = triggerCounter % scenario.numBuses;
+            trigger.key = 36 + triggerCounter % 64;
+            trigger.rootKey = 60;
+            trigger.offset = 0;
+            trigger.tune = 0.75f + 0.5f * (float)(triggerCounter % 8) / 8.0f;
+            trigger.envelope.attack = 0.005f;
+            trigger.envelope.release = 0.05f;
+
+            if (scenario.loop) {
+                trigger.loopBegin = loopBegin;
+                trigger.loopEnd = loopEnd;
+            }
+
+            if (scenario.voiceFx) {
+                trigger.fxChain = std::make_shared<AudioEffectChain>();
+                trigger.fxChain->setEngine(&engine);
+
+                if (auto* fx{ trigger.fxChain->addEffectByTag("low_pass_filter") })
+                    fx->getParameters()[0].setValue(2000.0f + 500.0f * (float)(triggerCounter % 16), true);
+
+                trigger.fxChain->addEffectByTag("delay");
+            }
+
+            engine.triggerVoice(trigger);
+            ++triggerCounter;
+        }
+
+        engine.process(output.getChannelData(0), output.getChannelData(1), options.blockSize);
+
+        timings.push_back(engine.getStats().lastBlockTime);
+        voicesAccumulator += (double)g->getVoicePool().getNumActiveVoices();
+    }
+
+    engine.reset();
+
+    Result result{};
+
+    result.underruns = g->getAudioStreamPool().getNumUnderruns();
+
+    const auto cacheStats{ g->getBlockCache().getStats() };
+
+    if (cacheStats.hits + cacheStats.misses > 0)
+        result.cacheHitRate = 100.0 * (double)cacheStats.hits / (double)(cacheStats.hits + cacheStats.misses);
+
+    if (timings.empty())
+        return result;
+
+    result.mean = std::accumulate(timings.begin(), timings.end(), 0.0) / (double)timings.size();
+    result.averageVoices = voicesAccumulator / (double)timings.size();
+
+    std::sort(timings.begin(), timings.end());
+    result.p50 = percentile(timings, 0.5);
+    result.p99 = percentile(timings, 0.99);
+    result.max = timings.back();
+
+    return result;
+}
+
+void printHeader(const Options& options)
+{
+    const double budget{ 1.0e6 * options.blockSize / options.sampleRate };
+
+    std::printf("block size: %d frames @ %.0f Hz (budget %.1f us), %d blocks per scenario, %s\n\n",
+                options.blockSize, options.sampleRate, budget, options.numBlocks,
+                options.offline ? "non-realtime" : (std::to_string(options.numThreads) + " render thread(s)").c_str());
+
+    std::printf("%-32s %8s %10s %10s %10s %10s %8s %12s %8s %10s\n",
+                "scenario", "voices", "mean(us)", "p50(us)", "p99(us)", "max(us)", "load(%)", "voices/core", "hit(%)", "underruns");
+}
+
+void printResult(const Scenario& scenario, const Options& options, const Result& result)
+{
+    const double budget{ 1.0e6 * options.blockSize / options.sampleRate };
+    const double load{ 100.0 * result.mean / budget };
+
+    // Number of voices a single core could sustain at this block size,
+    // extrapolated from the worst-case (p99) callback cost.
+    const double voicesPerCore{ result.p99 > 0.0 ? result.averageVoices * budget / result.p99 : 0.0 };
+
+    std::printf("%-32s %8.1f %10.1f %10.1f %10.1f %10.1f %8.1f %12.0f %8.1f %10llu\n",
+                scenario.name.c_str(), result.averageVoices,
+                result.mean, result.p50, result.p99, result.max,
+                load, voicesPerCore, result.cacheHitRate, (unsigned long long)result.underruns);
+}
+
+std::string describe(const Scenario& scenario)
+{
+    std::string name{ scenario.ogg ? "ogg" : "wav" };
+    name += scenario.loop ? " looped" : " one-shot";
+
+    if (scenario.voiceFx)
+        name += " +fx";
+
+    name += " " + std::to_string(scenario.numVoices) + "v/" + std::to_string(scenario.numBuses) + "b";
+
+    return name;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    Options options{};
+    Scenario custom{};
+    bool hasCustomScenario{ false };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{ argv[i] };
+        const bool hasValue{ i + 1 < argc };
+
+        if (arg == "--block" && hasValue)
+            options.blockSize = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--blocks" && hasValue)
+            options.numBlocks = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--sr" && hasValue)
+            options.sampleRate = (float)std::atof(argv[++i]);
+        else if (arg == "--preload" && hasValue)
+            options.preloadSize = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cache" && hasValue)
+            options.cacheSize = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--threads" && hasValue)
+            options.numThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--voices" && hasValue) {
+            custom.numVoices = std::clamp(std::atoi(argv[++i]), 1, DEFAULT_VOICE_POOL_SIZE);
+            hasCustomScenario = true;
+        } else if (arg == "--buses" && hasValue)
+            custom.numBuses = std::clamp(std::atoi(argv[++i]), 1, NUM_BUSES);
+        else if (arg == "--loop")
+            custom.loop = true;
+        else if (arg == "--fx")
+            custom.voiceFx = true;
+        else if (arg == "--ogg")
+            custom.ogg = true;
+        else if (arg == "--offline")
+            options.offline = true;
+        else {
+            std::fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Scenario> scenarios{};
+
+    if (hasCustomScenario) {
+        scenarios.push_back(custom);
+    } else {
+        scenarios = {
+            { {}, 64,  4,  false, false, false },
+            { {}, 64,  4,  true,  false, false },
+            { {}, 256, 16, false, false, false },
+            { {}, 256, 16, true,  false, false },
+            { {}, 128, 8,  true,  true,  false },
+            { {}, 64,  4,  false, false, true  },
+            { {}, 64,  4,  true,  false, true  }
+        };
+    }
+
+    const auto fixtures{ generateFixtures() };
+
+    GlobalEngine::getInstance()->setBlockCacheSize((size_t)options.cacheSize << 20);
+
+    printHeader(options);
+
+    for (auto& scenario : scenarios) {
+        scenario.name = describe(scenario);
+        const auto result{ runScenario(scenario, options, fixtures) };
+        printResult(scenario, options, result);
+    }
+
+    GlobalEngine::destroy();
+
+    return 0;
+}
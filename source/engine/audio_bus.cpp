@@ -8,11 +8,14 @@
 
 #include "audio_bus.h"
 #include "engine.h"
+#include <algorithm>
+#include <bit>
 
 TW_NAMESPACE_BEGIN
 
 AudioBus::AudioBus()
     : engine{ nullptr }
+    , voiceIndex{ nullptr }
     , mixBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
     , params(NUM_PARAMS)
     , fxChain()
@@ -20,6 +23,8 @@ AudioBus::AudioBus()
     , voiceBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
     , busBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
     , sendBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
+    , output{ 0 }
+    , polyphony{ 0 }
 {
     params[GAIN].setName("gain");
     params[GAIN].setRange(0.0f, 16.0f); // Allow +24dB gain
@@ -38,17 +43,22 @@ void AudioBus::clearFxChain()
     fxTailCountdown = 0;
 }
 
-void AudioBus::prepareToPlay()
+void AudioBus::prepareToPlay(int maxFrames)
 {
     assert(engine != nullptr);
 
+    mixBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, maxFrames);
+    voiceBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, maxFrames);
+    busBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, maxFrames);
+    sendBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, maxFrames);
+
     fxChain.prepareToPlay();
     fxTailCountdown = 0;
     busBuffer.clear();
     sendBuffer.clear();
 }
 
-void AudioBus::trigger(const Voice::Trigger& voiceTrigger)
+bool AudioBus::trigger(const Voice::Trigger& voiceTrigger)
 {
     auto& voicePool{ GlobalEngine::getInstance()->getVoicePool() };
 
@@ -56,9 +66,51 @@ void AudioBus::trigger(const Voice::Trigger& voiceTrigger)
         voice->trigger(engine, voiceTrigger);
         voices.append(voice);
         assert(!voices.isEmpty());
+
+        if (voiceIndex != nullptr)
+            voiceIndex->add(voice);
+
+        return true;
     }
+
+    return false;
 }
 
+namespace {
+
+/**
+ * Tells whether the candidate voice should be stolen before the current one.
+ */
+bool isBetterVoiceToSteal(const Voice& candidate, const Voice& current, VoiceStealing policy, int key)
+{
+    const auto rank = [&](const Voice& voice) {
+        if (voice.isStolen())
+            return 0;
+
+        if (policy == VoiceStealing::SameKey)
+            return voice.isForKey(key) ? 1 : 2;
+
+        if (policy == VoiceStealing::ReleasedFirst)
+            return voice.isReleased() ? 1 : 2;
+
+        return 2;
+    };
+
+    const int candidateRank{ rank(candidate) };
+    const int currentRank{ rank(current) };
+
+    if (candidateRank != currentRank)
+        return candidateRank < currentRank;
+
+    if (policy == VoiceStealing::Quietest && candidate.getLevel() != current.getLevel())
+        return candidate.getLevel() < current.getLevel();
+
+    // Older voices have lower IDs
+    return candidate.getTrigger().voiceId < current.getTrigger().voiceId;
+}
+
+} // anonymous namespace
+
 void AudioBus::killAllVoices()
 {
     auto* voice{ voices.first() };
@@ -66,6 +118,9 @@ void AudioBus::killAllVoices()
     while (voice != nullptr) {
         auto* nextVoice{ voices.removeAndReturnNext(voice) };
 
+        if (voiceIndex != nullptr)
+            voiceIndex->remove(voice);
+
         if (auto* stream{ voice->getStream() })
             stream->returnToPool();
 
@@ -75,6 +130,37 @@ void AudioBus::killAllVoices()
     }
 }
 
+int AudioBus::getNumPlayingVoices() const
+{
+    int count{ 0 };
+    const auto* voice{ voices.first() };
+
+    while (voice != nullptr) {
+        if (!voice->isStolen())
+            ++count;
+
+        voice = voice->next();
+    }
+
+    return count;
+}
+
+Voice* AudioBus::findVoiceToSteal(VoiceStealing policy, int key, bool includeStolen)
+{
+    Voice* victim{ nullptr };
+    auto* voice{ voices.first() };
+
+    while (voice != nullptr) {
+        if ((includeStolen || !voice->isStolen())
+            && (victim == nullptr || isBetterVoiceToSteal(*voice, *victim, policy, key)))
+            victim = voice;
+
+        voice = voice->next();
+    }
+
+    return victim;
+}
+
 Voice* AudioBus::findVoiceWithId(int voiceId)
 {
     auto* voice{ voices.first() };
@@ -103,30 +189,42 @@ void AudioBus::forEachVoice(const std::function<void(Voice&)>& func)
 }
 
 void AudioBus::processAndMix(float* outL, float* outR, int numFrames)
+{
+    process(numFrames);
+    recycleVoices();
+    mix(outL, outR, numFrames);
+}
+
+void AudioBus::setEngine(Engine* eng, VoiceIndex* index)
+{
+    assert(eng != nullptr);
+    engine = eng;
+    voiceIndex = index;
+
+    fxChain.setEngine(engine);
+}
+
+void AudioBus::process(int numFrames)
 {
     assert(voiceBuffer.getNumFrames() >= numFrames);
     assert(busBuffer.getNumFrames() >= numFrames);
 
     // Copy sends (pre-voice-FX)
-    ::memcpy(busBuffer.getChannelData(0), sendBuffer.getChannelData(0), sizeof(float) * MIX_BUFFER_NUM_FRAMES);
-    ::memcpy(busBuffer.getChannelData(1), sendBuffer.getChannelData(1), sizeof(float) * MIX_BUFFER_NUM_FRAMES);
+    ::memcpy(busBuffer.getChannelData(0), sendBuffer.getChannelData(0), sizeof(float) * numFrames);
+    ::memcpy(busBuffer.getChannelData(1), sendBuffer.getChannelData(1), sizeof(float) * numFrames);
 
-    sendBuffer.clear();
+    sendBuffer.clear(numFrames);
 
     auto* voice{ voices.first() };
 
     // Process all the active voices
     while (voice != nullptr) {
         voice->process(voiceBuffer.getChannelData(0), voiceBuffer.getChannelData(1), numFrames);
-        busBuffer.mix(voiceBuffer);
+        busBuffer.mix(voiceBuffer, numFrames);
 
         if (voice->isOver()) {
             auto* nextVoice{ voices.removeAndReturnNext(voice) };
-
-            if (auto* stream{ voice->getStream() })
-                stream->returnToPool();
-
-            voice->resetAndReturnToPool();
+            finishedVoices.append(voice);
             voice = nextVoice;
         } else {
             voice = voice->next();
@@ -139,6 +237,30 @@ void AudioBus::processAndMix(float* outL, float* outR, int numFrames)
     // Apply bus effects
     fxChain.process(bufL, bufR, bufL, bufR, numFrames);
     fxTailCountdown = fxChain.getTailLength();
+}
+
+void AudioBus::recycleVoices()
+{
+    auto* voice{ finishedVoices.first() };
+
+    while (voice != nullptr) {
+        auto* nextVoice{ finishedVoices.removeAndReturnNext(voice) };
+
+        if (voiceIndex != nullptr)
+            voiceIndex->remove(voice);
+
+        if (auto* stream{ voice->getStream() })
+            stream->returnToPool();
+
+        voice->resetAndReturnToPool();
+        voice = nextVoice;
+    }
+}
+
+void AudioBus::mix(float* outL, float* outR, int numFrames)
+{
+    const float* bufL{ busBuffer.getChannelData(0) };
+    const float* bufR{ busBuffer.getChannelData(1) };
 
     float gain{ params[GAIN].getTargetValue() };
     float pan{ params[PAN].getTargetValue() };
@@ -169,22 +291,18 @@ void AudioBus::processAndMix(float* outL, float* outR, int numFrames)
     }
 }
 
-void AudioBus::setEngine(Engine* eng)
-{
-    assert(eng != nullptr);
-    engine = eng;
-
-    fxChain.setEngine(engine);
-}
-
 //==============================================================================
 
 AudioBusPool::AudioBusPool(Engine& audioEngine, int size)
     : engine{ audioEngine }
     , buses(size)
+    , threadPool{}
+    , linkedBuses(size, 0)
+    , numFramesToRender{ 0 }
+    , voiceIndex(GlobalEngine::getInstance()->getVoicePool().getSize())
 {
     for (auto& bus : buses)
-        bus.setEngine(&engine);
+        bus.setEngine(&engine, &voiceIndex);
 }
 
 void AudioBusPool::killAllVoices()
@@ -201,12 +319,25 @@ void AudioBusPool::clearFxChain()
 
 Voice* AudioBusPool::findVoiceWithId(int voiceId)
 {
+    return voiceIndex.findVoiceWithId(voiceId);
+}
+
+bool AudioBusPool::stealVoice(VoiceStealing policy, int key)
+{
+    Voice* victim{ nullptr };
+
     for (auto& bus : buses) {
-        if (auto* voice{ bus.findVoiceWithId(voiceId) })
-            return voice;
+        if (auto* voice{ bus.findVoiceToSteal(policy, key, false) }) {
+            if (victim == nullptr || isBetterVoiceToSteal(*voice, *victim, policy, key))
+                victim = voice;
+        }
     }
 
-    return nullptr;
+    if (victim == nullptr)
+        return false;
+
+    victim->steal();
+    return true;
 }
 
 void AudioBusPool::forEachVoice(const std::function<void(Voice&)>& func)
@@ -215,10 +346,124 @@ void AudioBusPool::forEachVoice(const std::function<void(Voice&)>& func)
         bus.forEachVoice(func);
 }
 
-void AudioBusPool::prepareToPlay()
+void AudioBusPool::prepareToPlay(int maxFrames)
 {
     for (auto& bus : buses)
-        bus.prepareToPlay();
+        bus.prepareToPlay(maxFrames);
+}
+
+void AudioBusPool::setNumRenderThreads(int numThreads)
+{
+    threadPool.reset();
+
+    // No point in running more threads than the available cores
+    if (const int numCores{ (int)std::thread::hardware_concurrency() }; numCores > 0)
+        numThreads = std::min(numThreads, numCores);
+
+    // Dependencies are tracked as bit masks, so the number of buses is limited
+    if (numThreads > 1 && getNumBuses() > 1 && getNumBuses() <= core::ThreadPool::maxTasks)
+        threadPool = std::make_unique<core::ThreadPool>(numThreads - 1);
+}
+
+int AudioBusPool::getNumRenderThreads() const noexcept
+{
+    return threadPool == nullptr ? 1 : threadPool->getNumThreads() + 1;
+}
+
+void AudioBusPool::processAndMix(float* const* outputs, int numOutputs, int offset, int numFrames)
+{
+    assert(numOutputs >= MIX_BUFFER_NUM_CHANNELS);
+
+    if (threadPool == nullptr) {
+        for (auto& bus : buses) {
+            bus.process(numFrames);
+            bus.recycleVoices();
+            mix(bus, outputs, numOutputs, offset, numFrames);
+        }
+
+        return;
+    }
+
+    updateDependencies();
+
+    numFramesToRender = numFrames;
+    threadPool->run(*this);
+
+    // Recycle and mix on the calling thread in the bus order
+    for (auto& bus : buses) {
+        bus.recycleVoices();
+        mix(bus, outputs, numOutputs, offset, numFrames);
+    }
+}
+
+void AudioBusPool::runTask(int index)
+{
+    buses[(size_t)index].process(numFramesToRender);
+}
+
+void AudioBusPool::mix(AudioBus& bus, float* const* outputs, int numOutputs, int offset, int numFrames)
+{
+    int out{ bus.getOutput() * MIX_BUFFER_NUM_CHANNELS };
+
+    // Fall back to the main output if the direct out is not provided
+    if (out < 0 || out + 1 >= numOutputs)
+        out = 0;
+
+    bus.mix(outputs[out] + offset, outputs[out + 1] + offset, numFrames);
+}
+
+void AudioBusPool::updateDependencies()
+{
+    const int numBuses{ getNumBuses() };
+
+    std::fill(linkedBuses.begin(), linkedBuses.end(), 0);
+
+    const auto collectLinks = [&](int busIndex, AudioEffectChain& fxChain) {
+        for (int i = 0; i < fxChain.getNumEffects(); ++i) {
+            const int link{ fxChain.getEffectByIndex(i)->getLinkedBus() };
+
+            if (link >= 0 && link < numBuses && link != busIndex)
+                linkedBuses[(size_t)link] |= uint64_t(1) << busIndex;
+        }
+    };
+
+    for (int b = 0; b < numBuses; ++b) {
+        auto& bus{ buses[(size_t)b] };
+        collectLinks(b, bus.getFxChain());
+
+        auto* voice{ bus.voices.first() };
+
+        while (voice != nullptr) {
+            if (auto& voiceFxChain{ voice->getTrigger().fxChain })
+                collectLinks(b, *voiceFxChain);
+
+            voice = voice->next();
+        }
+    }
+
+    // Buses sharing a linked bus are processed one after another in the
+    // bus order, the same way they would be when processed sequentially.
+    threadPool->reset(numBuses);
+
+    for (int b = 0; b < numBuses; ++b) {
+        uint64_t group{ linkedBuses[(size_t)b] };
+
+        if (group == 0)
+            continue;
+
+        group |= uint64_t(1) << b;
+
+        int prev{ std::countr_zero(group) };
+        group &= group - 1;
+
+        while (group != 0) {
+            const int next{ std::countr_zero(group) };
+            group &= group - 1;
+
+            threadPool->addDependency(next, prev);
+            prev = next;
+        }
+    }
 }
 
 TW_NAMESPACE_END
@@ -15,6 +15,9 @@
 #include "voice.h"
 #include "core/audio_buffer.h"
 #include "core/list.h"
+#include "core/thread_pool.h"
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <functional>
 
@@ -50,15 +53,49 @@ public:
 
     core::AudioBuffer<float>& getSendBuffer() noexcept { return sendBuffer; }
 
+    /**
+     * Route the bus to a stereo output of the engine.
+     * Output 0 is the main output, others are direct outs.
+     */
+    void setOutput(int index) noexcept { output = index; }
+    int getOutput() const noexcept { return output; }
+
     void clearFxChain();
 
-    void prepareToPlay();
+    /**
+     * Prepare the bus to process up to maxFrames at once.
+     */
+    void prepareToPlay(int maxFrames);
 
-    void trigger(const Voice::Trigger& voiceTrigger);
+    /**
+     * Start a new voice on this bus.
+     * @returns false if no voice is available.
+     */
+    bool trigger(const Voice::Trigger& voiceTrigger);
     void killAllVoices();
 
     Voice* findVoiceWithId(int voiceId);
 
+    /**
+     * Limit the number of voices playing on this bus.
+     * When the limit is reached, triggering a new voice steals one.
+     * Zero means no limit.
+     */
+    void setPolyphony(int maxVoices) noexcept { polyphony = maxVoices; }
+    int getPolyphony() const noexcept { return polyphony; }
+
+    /**
+     * Returns the number of voices playing, not counting the stolen ones.
+     */
+    int getNumPlayingVoices() const;
+
+    /**
+     * Find a voice to be stolen according to the policy.
+     * Voices being already stolen are considered only if includeStolen
+     * is set, in which case they are chosen first.
+     */
+    Voice* findVoiceToSteal(VoiceStealing policy, int key, bool includeStolen);
+
     void forEachVoice(const std::function<void(Voice&)>& func);
 
     void processAndMix(float* outL, float* outR, int numFrames);
@@ -67,9 +104,27 @@ private:
 
     friend class AudioBusPool;
 
-    void setEngine(Engine* eng);
+    void setEngine(Engine* eng, VoiceIndex* index);
+
+    /**
+     * Render voices and bus effects into the bus buffer.
+     * Finished voices are put aside to be recycled later,
+     * so that this can run concurrently for different buses.
+     */
+    void process(int numFrames);
+
+    /**
+     * Return finished voices and their streams to the global pools.
+     */
+    void recycleVoices();
+
+    /**
+     * Apply bus gain and panning and mix into the output.
+     */
+    void mix(float* outL, float* outR, int numFrames);
 
     Engine* engine;
+    VoiceIndex* voiceIndex;             ///< Engine's voices index.
     core::AudioBuffer<float> mixBuffer;
 
     AudioParameterPool params;
@@ -77,15 +132,27 @@ private:
     AudioEffectChain fxChain;
     int fxTailCountdown;
 
-    core::List<Voice> voices;   ///< Active voices.
+    core::List<Voice> voices;           ///< Active voices.
+    core::List<Voice> finishedVoices;   ///< Voices to be recycled.
     core::AudioBuffer<float> voiceBuffer;
     core::AudioBuffer<float> busBuffer;
     core::AudioBuffer<float> sendBuffer;
+
+    std::atomic<int> output;            ///< Stereo output index.
+    std::atomic<int> polyphony;         ///< Max number of playing voices.
 };
 
 //==============================================================================
 
-class AudioBusPool
+/**
+ * Collection of the engine's buses.
+ *
+ * Buses can optionally be rendered in parallel on a pool of threads.
+ * Buses linked via sends (or other effects accessing another bus) are
+ * ordered by their index, so that the output is identical to the
+ * sequential rendering.
+ */
+class AudioBusPool : public core::ThreadPool::Graph
 {
 public:
     AudioBusPool() = delete;
@@ -103,15 +170,59 @@ public:
     void killAllVoices();
     void clearFxChain();
 
+    /**
+     * Returns an active voice by its ID (constant-time).
+     */
     Voice* findVoiceWithId(int voiceId);
 
-    void prepareToPlay();
+    /**
+     * Returns the active voices playing a key on any bus.
+     */
+    VoiceIndex::KeyList& getVoicesForKey(int key) { return voiceIndex.getVoicesForKey(key); }
+
+    /**
+     * Fade out a voice on any bus to free a voice and a stream.
+     * @returns false if all the voices are being stolen already.
+     */
+    bool stealVoice(VoiceStealing policy, int key);
+
+    void prepareToPlay(int maxFrames);
 
     void forEachVoice(const std::function<void(Voice&)>& func);
 
+    /**
+     * Enable parallel rendering of the buses.
+     * The number of threads includes the audio thread, so
+     * a value of 1 or less disables the parallel rendering. The number
+     * of threads is limited to the number of available CPU cores.
+     *
+     * @note This must not be called while the audio is being processed.
+     */
+    void setNumRenderThreads(int numThreads);
+    int getNumRenderThreads() const noexcept;
+
+    /**
+     * Render all the buses and mix them into their stereo outputs
+     * starting at a given frame offset.
+     */
+    void processAndMix(float* const* outputs, int numOutputs, int offset, int numFrames);
+
+    // core::ThreadPool::Graph
+    void runTask(int index) override;
+
 private:
+
+    void updateDependencies();
+    void mix(AudioBus& bus, float* const* outputs, int numOutputs, int offset, int numFrames);
+
     Engine& engine;
     std::vector<AudioBus> buses;
+
+    std::unique_ptr<core::ThreadPool> threadPool;
+    std::vector<uint64_t> linkedBuses;
+    int numFramesToRender;
+
+    VoiceIndex voiceIndex;
 };
 
 TW_NAMESPACE_END
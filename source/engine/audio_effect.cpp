@@ -7,6 +7,7 @@
 // *****************************************************************************
 
 #include "audio_effect.h"
+#include "engine.h"
 #include "fx/filters.h"
 #include "fx/delay.h"
 #include "fx/send.h"
@@ -80,6 +81,7 @@ void AudioEffectChain::prepareToPlay()
     for (auto& fx : effects)
         fx->prepareToPlay();
 
+    mixBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, engine->getFrameSize());
     mixBuffer.clear();
 }
 
@@ -54,6 +54,13 @@ public:
      */
     virtual int getTailLength() const { return 0; }
 
+    /**
+     * Returns the index of another bus this effect accesses
+     * while processing (e.g. a send target), or -1 if none.
+     * This is used to order buses when rendering in parallel.
+     */
+    virtual int getLinkedBus() const { return -1; }
+
     const std::string& getId() const noexcept { return effectId; }
     void setId(const std::string& fxId) { effectId = fxId; }
 
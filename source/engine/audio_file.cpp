@@ -8,15 +8,17 @@
 
 #include "audio_file.h"
 #include "core/string_utils.h"
+#include "core/mapped_file.h"
+#include "core/pcm.h"
 #include "vorbis/vorbisfile.h"
 #if TONEWHEEL_WITH_OPUS
 #   include "opusfile.h"
 #endif
-#include <fstream>
-#include <vector>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <cassert>
-#include <iostream>
+#include <cstdio>
 
 TW_NAMESPACE_BEGIN
 
@@ -42,6 +44,11 @@ namespace decoder {
 
 /**
  * Decoder for uncompressed WAV PCM file format.
+ *
+ * The file is accessed via a shared memory mapping, so that
+ * opening and seeking do not cost any system calls once the file
+ * has been mapped, and the samples are converted straight from
+ * the mapped pages.
  */
 struct WavPCM : public AudioFile::Decoder
 {
@@ -74,7 +81,9 @@ struct WavPCM : public AudioFile::Decoder
 
     constexpr static uint32_t RIFF = 0x45564157;
 
-    std::unique_ptr<std::ifstream> file{ nullptr };
+    using ConvertFunc = void (*)(const uint8_t*, int, float*, float*, size_t);
+
+    core::MappedFile::Ptr file{ nullptr };
     Format format{ Format_PCM };
     int nChannels{ 0 };
     int sRate{ 0 };
@@ -83,60 +92,72 @@ struct WavPCM : public AudioFile::Decoder
     size_t dataChunkPos{ 0 };
     size_t numberOfSamples{ 0 };
     size_t readSamplePos{ 0 };
-
-    // Raw data read buffer
-    std::vector<uint8_t> buffer{};
+    ConvertFunc convert{ nullptr };
 
     core::Error open (const std::string& path) override
     {
-        file.reset(new std::ifstream(path, std::ios::in | std::ios::binary));
-        if (!file->is_open())
+        file = core::MappedFile::open(path);
+
+        if (file == nullptr)
             return errors::failedToOpen;
 
         auto res{ readHeader() };
 
-        if (res.failed())
+        if (res.failed()) {
+            close();
             return res;
+        }
 
-        file->seekg(dataChunkPos);
         readSamplePos = 0;
 
-        if (format != Format_PCM)
-            return errors::invalidFormat;
-
-        if (nChannels != 1 && nChannels != 2)
+        if (nChannels != 1 && nChannels != 2) {
+            close();
             return errors::unsupportedChannelsCount;
+        }
+
+        convert = nullptr;
 
-        if (bitsPerSample != 8 && bitsPerSample != 16 && bitsPerSample != 24)
+        if (format == Format_PCM) {
+            switch (bitsPerSample) {
+                case 8:  convert = &core::pcm::convertU8; break;
+                case 16: convert = &core::pcm::convertS16; break;
+                case 24: convert = &core::pcm::convertS24; break;
+                default: break;
+            }
+        } else if (format == Format_FloatingPoint) {
+            if (bitsPerSample == 32)
+                convert = &core::pcm::convertF32;
+        } else {
+            close();
+            return errors::invalidFormat;
+        }
+
+        if (convert == nullptr) {
+            close();
             return errors::unsupportedSampleFormat;
+        }
 
         return {};
     }
 
     void close() override
     {
-        if (file != nullptr && file->is_open()) {
-            file->close();
-            file.reset();
-        }
+        file.reset();
     }
 
     bool isOpen() override
     {
-        return file != nullptr && file->is_open();
+        return file != nullptr;
     }
 
     core::Error seek(size_t frame) override
     {
-        if (file == nullptr || ! file->is_open())
+        if (file == nullptr)
             return errors::invalidFile;
 
         if (frame >= numberOfSamples)
             return errors::outOfRange;
 
-        const size_t pos{ dataChunkPos + frame * (bitsPerSample / 8) * nChannels };
-        file->seekg(pos);
-
         readSamplePos = frame;
 
         return {};
@@ -144,58 +165,16 @@ struct WavPCM : public AudioFile::Decoder
 
     int read(int nFrames, float* left, float* right) override
     {
-        size_t n = std::min((size_t)nFrames, availableSamples());
-        float* out[] = {left, right};
-
-        switch (nChannels) {
-            // Mono
-            case 1:
-            {
-                switch (bitsPerSample)
-                {
-                case 8:
-                    n = readAsFloats<1, 1>(out, n);
-                    break;
-                case 16:
-                    n = readAsFloats<2, 1>(out, n);
-                    break;
-                case 24:
-                    n = readAsFloats<3, 1>(out, n);
-                    break;
-                default:
-                    return 0;
-                }
-
-                ::memcpy (right, left, sizeof (float) * n);
-                break;
-            }
-            // Stereo
-            case 2:
-            {
-                switch (bitsPerSample)
-                {
-                case 8:
-                    n = readAsFloats<1, 2>(out, n);
-                    break;
-                case 16:
-                    n = readAsFloats<2, 2>(out, n);
-                    break;
-                case 24:
-                    n = readAsFloats<3, 2>(out, n);
-                    break;
-                default:
-                    return 0;
-                }
+        if (file == nullptr || convert == nullptr)
+            return 0;
 
-                break;
-            }
-            default:
-                return 0;
-        }
+        const size_t n{ std::min((size_t)nFrames, availableSamples()) };
+        const uint8_t* src{ file->getData() + dataChunkPos + readSamplePos * blockAlign };
 
+        convert(src, nChannels, left, right, n);
         readSamplePos += n;
 
-        return (int) n;
+        return (int)n;
     }
 
     float getSampleRate() const override
@@ -203,6 +182,12 @@ struct WavPCM : public AudioFile::Decoder
         return (float)sRate;
     }
 
+    void prefetch(size_t frame, int numFrames) override
+    {
+        if (file != nullptr && numFrames > 0)
+            file->prefetch(dataChunkPos + frame * blockAlign, (size_t)numFrames * blockAlign);
+    }
+
     int getNumChannels() const override
     {
         return nChannels;
@@ -210,166 +195,139 @@ struct WavPCM : public AudioFile::Decoder
 
 private:
 
+    template<typename T>
+    static T readValue(const uint8_t* ptr)
+    {
+        T value;
+        ::memcpy(&value, ptr, sizeof(T));
+        return value;
+    }
+
     core::Error readHeader()
     {
         assert(file != nullptr);
-        assert(file->is_open());
 
-        // Make sure we're at the start of the file before reading the header.
-        file->seekg(0);
+        const uint8_t* data{ file->getData() };
+        const size_t size{ file->getSize() };
+        size_t pos{ 0 };
 
-        uint32_t chunkId = 0;
-        uint32_t chunkSize = 0;
-        bool foundData = false;
+        bool foundRiff{ false };
+        bool foundFormat{ false };
 
         // Reading up to the DATA chunk
-        while (!foundData) {
-            if (file->eof())
-                return errors::unexpectedEof;
-
-            file->read((char*)&chunkId, sizeof(chunkId));
-            file->read((char*)&chunkSize, sizeof(chunkId));
+        while (pos + 8 <= size) {
+            const uint32_t chunkId{ readValue<uint32_t>(&data[pos]) };
+            const uint32_t chunkSize{ readValue<uint32_t>(&data[pos + 4]) };
+            pos += 8;
 
             switch (static_cast<Chunk>(chunkId)) {
                 case Chunk_RiffHeader:
                 {
-                    uint32_t wav = 0;
-                    file->read((char*) &wav, sizeof (wav));
-
-                    if (wav != RIFF)
+                    if (pos + 4 > size || readValue<uint32_t>(&data[pos]) != RIFF)
                         return errors::invalidFormat;
 
+                    foundRiff = true;
+                    pos += 4;
                     break;
                 }
                 case Chunk_Format:
                 {
-                    uint16_t fmt = 0;
-                    uint16_t ch;    // number of channels
-                    uint32_t sr;    // sample rate
-                    uint32_t br;    // byte rate
-                    uint16_t ba;    // block align
-                    uint16_t bps;   // bits per sample
-
-                    file->read((char*)&fmt, sizeof(fmt));
-                    file->read((char*)&ch, sizeof(ch));
-                    file->read((char*)&sr, sizeof(sr));
-                    file->read((char*)&br, sizeof(br));
-                    file->read((char*)&ba, sizeof(ba));
-                    file->read((char*)&bps, sizeof(bps));
+                    if (chunkSize < 0x10 || pos + chunkSize > size)
+                        return errors::invalidHeader;
+
+                    uint16_t fmt{ readValue<uint16_t>(&data[pos]) };
+                    const uint16_t ch{ readValue<uint16_t>(&data[pos + 2]) };
+                    const uint32_t sr{ readValue<uint32_t>(&data[pos + 4]) };
+                    const uint16_t ba{ readValue<uint16_t>(&data[pos + 12]) };
+                    const uint16_t bps{ readValue<uint16_t>(&data[pos + 14]) };
+
+                    // The actual format is the first two bytes of the sub-format GUID
+                    if (fmt == Format_Extensible && chunkSize >= 0x1A)
+                        fmt = readValue<uint16_t>(&data[pos + 0x18]);
 
                     format = static_cast<Format>(fmt);
                     nChannels = ch;
-                    sRate = sr;
+                    sRate = (int)sr;
                     blockAlign = ba;
                     bitsPerSample = bps;
 
-                    if (ba != ch * bps / 8)
+                    if (ba == 0 || ba != ch * bps / 8)
                         return errors::invalidFormat;
 
-                    if (chunkSize > 0x10)
-                        file->seekg(chunkSize - 0x10, std::ios_base::cur);
-
+                    foundFormat = true;
+                    pos += chunkSize + (chunkSize & 1);
                     break;
                 }
                 case Chunk_Data:
                 {
-                    foundData = true;
-                    numberOfSamples = chunkSize / blockAlign;
-                    dataChunkPos = file->tellg();
-                    break;
+                    if (!foundRiff || !foundFormat)
+                        return errors::invalidHeader;
+
+                    // Tolerate truncated files
+                    const size_t dataSize{ std::min((size_t)chunkSize, size - pos) };
+
+                    numberOfSamples = dataSize / blockAlign;
+                    dataChunkPos = pos;
+                    return {};
                 }
                 default:
-                    // Skip unknown chunk
-                    file->seekg((size_t)file->tellg() + (size_t) chunkSize);
+                    // Skip unknown chunk (chunks are word-aligned)
+                    pos += chunkSize + (chunkSize & 1);
                     break;
             }
         }
 
-        if (!foundData)
-            return errors::invalidFormat;
-
-        return {};
+        return errors::unexpectedEof;
     }
 
     size_t availableSamples()
     {
         return numberOfSamples - readSamplePos;
     }
-
-    template<int BytesPerSample>
-    inline static float convert (uint8_t* data)
-    {
-        constexpr int maxValue = 1 << (BytesPerSample * 8);
-        constexpr int midValue = maxValue >> 1;
-        constexpr float norm = 1.0f / (float) midValue;
-
-        int value = 0;
-
-        if constexpr (BytesPerSample == 1)
-            value = (int) *data - midValue;
-        else if constexpr (BytesPerSample == 2)
-            value = (int) *((int16_t*) data);
-        else if constexpr (BytesPerSample == 3)
-        {
-            value = int (data[0]) | (int (data[1]) << 8) | ((int (data[2]) << 16));
-
-            // Restore sign
-            if ((value & 0x800000) != 0)
-                value |= 0xFF000000;
-        }
-
-        return float (value) * norm;
-    }
-
-    template<int BytesPerSample, int Channels>
-    size_t readAsFloats (float** out, size_t n)
-    {
-        size_t bufferSize = n * BytesPerSample * Channels;
-
-        // Grow the buffer if needed.
-        if (buffer.size() < bufferSize)
-            buffer.resize (bufferSize);
-
-        file->read ((char*) buffer.data(), bufferSize);
-        auto readBytes = file->gcount();
-        size_t readSamples = readBytes / BytesPerSample / Channels;
-
-        size_t bufferIdx = 0;
-
-        for (size_t i = 0; i < readSamples; ++i)
-        {
-            for (int c = 0; c < Channels; ++c)
-            {
-                out[c][i] = convert<BytesPerSample> (&buffer.data()[bufferIdx]);
-                bufferIdx += BytesPerSample;
-            }
-        }
-
-        return readSamples;
-    }
-
 };
 
 //==============================================================================
 
+/**
+ * Decoder for Ogg Vorbis files.
+ *
+ * The compressed data is read from a shared memory mapping of the file
+ * rather than via stdio, which allows prefetching it asynchronously.
+ */
 struct OggVorbis : public AudioFile::Decoder
 {
     OggVorbis_File vorbisFile{};
     bool fileIsOpen{ false };
     float sampleRate{};
 
+    core::MappedFile::Ptr file{ nullptr };
+    size_t filePos{ 0 };
+    double bytesPerFrame{ 0.0 };
+
     core::Error open(const std::string& path) override
     {
-        const auto res{ ov_fopen(path.c_str(), &vorbisFile) };
-
         fileIsOpen = false;
 
-        if (res != 0)
+        file = core::MappedFile::open(path);
+
+        if (file == nullptr)
+            return errors::failedToOpen;
+
+        filePos = 0;
+
+        const ov_callbacks callbacks{ &readCallback, &seekCallback, nullptr, &tellCallback };
+
+        if (ov_open_callbacks(this, &vorbisFile, nullptr, 0, callbacks) != 0) {
+            file.reset();
             return core::Error("Failed to open file");
+        }
 
         fileIsOpen = true;
         sampleRate = (float)vorbisFile.vi->rate;
 
+        const auto totalFrames{ ov_pcm_total(&vorbisFile, -1) };
+        bytesPerFrame = totalFrames > 0 ? (double)file->getSize() / (double)totalFrames : 0.0;
+
         return {};
     }
 
@@ -379,6 +337,8 @@ struct OggVorbis : public AudioFile::Decoder
             ov_clear (&vorbisFile);
             fileIsOpen = false;
         }
+
+        file.reset();
     }
 
     bool isOpen() override
@@ -415,7 +375,9 @@ struct OggVorbis : public AudioFile::Decoder
                 break;
 
             ::memcpy(&left[framesRead], pcm[0], sizeof(float) * currentFrames);
-            ::memcpy(&right[framesRead], pcm[vorbisFile.vi->channels < 2 ? 0 : 1], sizeof(float) * currentFrames);
+
+            if (vorbisFile.vi->channels > 1)
+                ::memcpy(&right[framesRead], pcm[1], sizeof(float) * currentFrames);
 
             framesRead += currentFrames;
             framesRemained -= currentFrames;
@@ -433,6 +395,60 @@ struct OggVorbis : public AudioFile::Decoder
     {
         return vorbisFile.vi->channels;
     }
+
+    void prefetch(size_t frame, int numFrames) override
+    {
+        if (file == nullptr || numFrames <= 0)
+            return;
+
+        // The compressed position is estimated from the average bitrate,
+        // with some margin on both sides to compensate for its variation.
+        const double begin{ (double)frame * bytesPerFrame };
+        const double length{ (double)numFrames * bytesPerFrame };
+        const double margin{ 0.25 * length };
+
+        const size_t offset{ (size_t)std::max(0.0, begin - margin) };
+        file->prefetch(offset, (size_t)(length + 2.0 * margin));
+    }
+
+private:
+
+    static size_t readCallback(void* ptr, size_t size, size_t nmemb, void* datasource)
+    {
+        auto* self{ static_cast<OggVorbis*>(datasource) };
+        const size_t available{ self->file->getSize() - self->filePos };
+        const size_t n{ size == 0 ? 0 : std::min(nmemb, available / size) };
+
+        ::memcpy(ptr, self->file->getData() + self->filePos, n * size);
+        self->filePos += n * size;
+
+        return n;
+    }
+
+    static int seekCallback(void* datasource, ogg_int64_t offset, int whence)
+    {
+        auto* self{ static_cast<OggVorbis*>(datasource) };
+        const auto size{ (ogg_int64_t)self->file->getSize() };
+
+        ogg_int64_t pos{ offset };
+
+        if (whence == SEEK_CUR)
+            pos += (ogg_int64_t)self->filePos;
+        else if (whence == SEEK_END)
+            pos += size;
+
+        if (pos < 0 || pos > size)
+            return -1;
+
+        self->filePos = (size_t)pos;
+
+        return 0;
+    }
+
+    static long tellCallback(void* datasource)
+    {
+        return (long)static_cast<OggVorbis*>(datasource)->filePos;
+    }
 };
 
 //==============================================================================
@@ -537,6 +553,8 @@ struct Opus : public AudioFile::Decoder
 AudioFile::AudioFile(const std::string& filePath, Format fileFormat)
     : path{ filePath }
     , format{ fileFormat }
+    , sampleRate{ 0.0f }
+    , numChannels{ 0 }
     , decoder{ nullptr }
 {
     // Create decoder for given file format
@@ -611,6 +629,12 @@ int AudioFile::read(int numFrames, float* left, float* right)
     return decoder->read(numFrames, left, right);
 }
 
+void AudioFile::prefetch(int frame, int numFrames)
+{
+    if (decoder != nullptr && frame >= 0)
+        decoder->prefetch((size_t)frame, numFrames);
+}
+
 AudioFile::Format AudioFile::guessFormatFromFileName(const std::string& path)
 {
     const auto lowerCasePath{ core::str::toLower(path) };
@@ -50,9 +50,20 @@ public:
         virtual void close() = 0;
         virtual bool isOpen() = 0;
         virtual core::Error seek(size_t frame) = 0;
+
+        /**
+         * Read planar frames. Mono files only write the left channel,
+         * in which case right may be nullptr.
+         */
         virtual int read(int numFrames, float* left, float* right) = 0;
         virtual float getSampleRate() const = 0;
         virtual int getNumChannels() const = 0;
+
+        /**
+         * Hint that a range of frames will be read soon.
+         * This must not block: the data should be fetched asynchronously.
+         */
+        virtual void prefetch(size_t /* frame */, int /* numFrames */) {}
     };
 
     //------------------------------------------------------
@@ -74,10 +85,21 @@ public:
     core::Error open();
     void close();
     core::Error seek(int frame);
+
+    /**
+     * Read planar frames. Mono files only write the left channel.
+     */
     int read(int numFrames, float* left, float* right);
+    void prefetch(int frame, int numFrames);
     float getSampleRate() const noexcept { return sampleRate; }
     int getNumChannels() const noexcept { return numChannels; }
 
+    /**
+     * Set the file properties without opening it,
+     * when they are already known (e.g. from the preload cache).
+     */
+    void setProperties(float rate, int channels) noexcept { sampleRate = rate; numChannels = channels; }
+
     static Format guessFormatFromFileName(const std::string& filePath);
 
 protected:
@@ -9,17 +9,44 @@
 #include "audio_stream.h"
 #include "global_engine.h"
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
 TW_NAMESPACE_BEGIN
 
-AudioStream::AudioStream(int bufferSize)
+namespace {
+
+int64_t now() noexcept
+{
+    return (int64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+float toSeconds(int64_t ticks) noexcept
+{
+    return std::chrono::duration<float>(std::chrono::steady_clock::duration(ticks)).count();
+}
+
+constexpr int loopDecodeBlockSize{ CACHE_BLOCK_SIZE };  ///< Loop frames decoded per run.
+
+} // anonymous namespace
+
+AudioStream::AudioStream()
     : state{ State::Idle }
     , sample{ nullptr }
     , worker{ nullptr }
-    , buffer(MIX_BUFFER_NUM_CHANNELS, bufferSize)
+    , blocking{ false }
+    , chunks{}
+    , numChunks{ 0 }
+    , chunkFrames{ STREAM_BUFFER_CHUNK_SIZE }
+    , bufferSize{ 0 }
+    , numChannels{ MIX_BUFFER_NUM_CHANNELS }
+    , playbackRate{ DEFAULT_SAMPLE_RATE_F }
+    , refillRequestTime{ 0 }
     , xfadeBuffer(MIX_BUFFER_NUM_CHANNELS, DEFAULT_XFADE_BUFFER_SIZE)
     , xfadeEnvelope(MIX_BUFFER_NUM_CHANNELS, DEFAULT_XFADE_BUFFER_SIZE)
     , samplesInBuffer{ 0 }
+    , underruns{ 0 }
     , samplesInXfadeBuffer{ 0 }
     , readIndex{ 0 }
     , writeIndex{ 0 }
@@ -29,27 +56,60 @@ AudioStream::AudioStream(int bufferSize)
     , loopBegin{ -1 }
     , loopEnd{ -1 }
     , loopXfadeSize{ 128 }
-    , file{ nullptr }
+    , residentLoop{ nullptr }
+    , residentLoopChecked{ false }
+    , playingResidentLoop{ false }
+    , decodingLoop{ nullptr }
+    , loopFramesDecoded{ 0 }
+    , streamReader{}
+    , loopReader{}
 {
 }
 
 AudioStream::~AudioStream() = default;
 
-void AudioStream::trigger(Sample::Ptr streamingSample, core::Worker* streamingWorker)
+void AudioStream::trigger(Sample::Ptr streamingSample, core::Worker* streamingWorker, bool blockingStream, float rate)
 {
     assert(streamingSample != nullptr);
     assert(streamingWorker != nullptr);
 
     sample = streamingSample;
     worker = streamingWorker;
+    blocking = blockingStream;
+
+    // A chunk holds the channels one after the other,
+    // so that a mono stream gets twice as many frames.
+    numChannels = sample->getNumChannels();
+    chunkFrames = STREAM_BUFFER_CHUNK_SIZE * MIX_BUFFER_NUM_CHANNELS / numChannels;
+    playbackRate = std::max(1.0f, rate);
+    refillRequestTime = now();
+
+    // Buffer the longest of the minimum duration and a margin over the refill latency
+    auto& pool{ GlobalEngine::getInstance()->getAudioStreamPool() };
+    const float duration{ std::max(STREAM_BUFFER_MIN_DURATION, STREAM_REFILL_LATENCY_MARGIN * pool.getRefillLatency()) };
+    const int wantedChunks{ std::clamp((int)std::ceil(playbackRate * duration / (float)chunkFrames),
+                                       MIN_STREAM_BUFFER_CHUNKS, MAX_STREAM_BUFFER_CHUNKS) };
+
+    if (numChunks > 0)
+        pool.returnChunks(chunks.data(), numChunks);
+
+    numChunks = pool.takeChunks(chunks.data(), wantedChunks);
+    bufferSize = numChunks * chunkFrames;
+    assert(bufferSize > 0);
 
     samplesInBuffer = 0;
+    underruns = 0;
     samplesInXfadeBuffer = 0;
     readIndex = 0;
     writeIndex = 0;
     samplePos = offset;
-    loopBegin = -1;
-    loopEnd = -1;
+
+    // Loop end must be outside of the preloaded region
+    if (loopEnd >= 0)
+        loopEnd = std::max(sample->getNumPreloadedFrames(), loopEnd);
+
+    assert(loopEnd < 0 || loopBegin < loopEnd);
+
     state = State::Init;
 
     worker->addJob(this);
@@ -73,11 +133,6 @@ void AudioStream::setLoop(int begin, int end, int xfade)
     loopBegin = std::min(begin, end);
     loopEnd = std::max(begin, end);
     loopXfadeSize = std::max(DEFAULT_XFADE_BUFFER_SIZE, xfade);
-
-    // Loop end must be outside of the preloaded region
-    loopEnd = std::max(sample->getNumPreloadedFrames(), loopEnd);
-
-    assert(loopBegin < loopEnd);
 }
 
 void AudioStream::setOffset(int offs)
@@ -89,7 +144,9 @@ void AudioStream::setOffset(int offs)
 int AudioStream::fillBuffers(float* left, float* right, int nFrames)
 {
     assert(left != nullptr);
-    assert(right != nullptr);
+    assert(right != nullptr || numChannels == 1);
+
+    const bool stereo{ numChannels > 1 };
 
     int generatedFrames{ 0 };
     const auto preloadedFramesAvailable{ sample->getNumPreloadedFrames() - samplePos };
@@ -101,7 +158,10 @@ int AudioStream::fillBuffers(float* left, float* right, int nFrames)
         const auto n{ std::min(preloadedFramesAvailable, nFrames) };
 
         ::memcpy(left, &prebuffer.getChannelData(0)[samplePos], sizeof(float) * n);
-        ::memcpy(right, &prebuffer.getChannelData(1)[samplePos], sizeof(float) * n);
+
+        if (stereo)
+            ::memcpy(right, &prebuffer.getChannelData(1)[samplePos], sizeof(float) * n);
+
         samplePos += n;
 
         if (nFrames == n)
@@ -109,20 +169,29 @@ int AudioStream::fillBuffers(float* left, float* right, int nFrames)
 
         nFrames -= n;
         left += n;
-        right += n;
+        right = stereo ? right + n : right;
         generatedFrames += n;
     }
 
+    if (blocking && samplesInBuffer < nFrames)
+        waitForFrames(nFrames);
+
     // Delivering from the streaming buffer
     int framesAvailable{ samplesInBuffer };
     int framesToCopy{ std::min (framesAvailable, nFrames) };
 
     while (framesToCopy > 0) {
-        int copyThisTime = std::min((int) buffer.getNumFrames() - readIndex, framesToCopy);
-        ::memcpy(left, &buffer.getChannelData(0)[readIndex], sizeof(float) * copyThisTime);
-        ::memcpy(right, &buffer.getChannelData(1)[readIndex], sizeof(float) * copyThisTime);
+        const int ri{ readIndex };
+        const int copyThisTime{ std::min(getContiguousFrames(ri), framesToCopy) };
+        ::memcpy(left, getBufferData(0, ri), sizeof(float) * copyThisTime);
+        left += copyThisTime;
+
+        if (stereo) {
+            ::memcpy(right, getBufferData(1, ri), sizeof(float) * copyThisTime);
+            right += copyThisTime;
+        }
 
-        readIndex = (readIndex.load() + copyThisTime) % (int)buffer.getNumFrames();
+        readIndex = (ri + copyThisTime) % bufferSize;
         samplesInBuffer -= copyThisTime;
         framesToCopy -= copyThisTime;
 
@@ -131,9 +200,15 @@ int AudioStream::fillBuffers(float* left, float* right, int nFrames)
         generatedFrames += copyThisTime;
     }
 
-    // Schedule to read more samples if half of the buffer is empty
-    if (state == State::Streaming && (samplesInBuffer <= buffer.getNumFrames() / 2))
-        worker->addJob (this);
+    if (nFrames > 0 && samplesInBuffer == 0) {
+        if (state == State::Finishing)
+            state = State::Over;
+        else if (state == State::Init || state == State::Streaming)
+            ++underruns;
+    }
+
+    if (needsRefill())
+        requestRefill();
 
     return generatedFrames;
 }
@@ -147,12 +222,15 @@ bool AudioStream::readOne(float& left, float& right)
     {
         const auto& prebuffer{ sample->getPreloadedSamples() };
         left = prebuffer.getChannelData(0)[samplePos];
-        right = prebuffer.getChannelData(1)[samplePos];
+        right = numChannels > 1 ? prebuffer.getChannelData(1)[samplePos] : left;
 
         ++samplePos;
         return true;
     }
 
+    if (blocking && samplesInBuffer == 0)
+        waitForFrames(1);
+
     // Read from stream
     if (samplesInBuffer == 0) {
         left = 0.0f;
@@ -160,21 +238,22 @@ bool AudioStream::readOne(float& left, float& right)
 
         if (state == State::Finishing)
             state = State::Over;
+        else if (state == State::Init || state == State::Streaming)
+            ++underruns;
 
         return false;
     }
 
     const auto ri{ readIndex.load() };
-    left = buffer.getChannelData(0)[ri];
-    right = buffer.getChannelData(1)[ri];
+    left = *getBufferData(0, ri);
+    right = numChannels > 1 ? *getBufferData(1, ri) : left;
 
-    readIndex = (ri + 1) % (int)buffer.getNumFrames();
+    readIndex = (ri + 1) % bufferSize;
     --samplesInBuffer;
     ++samplePos;
 
-    // Schedule to read more samples if half of the buffer is empty
-    if (state == State::Streaming && (samplesInBuffer <= buffer.getNumFrames() / 2))
-        worker->addJob (this);
+    if (needsRefill())
+        requestRefill();
 
     return true;
 
@@ -192,11 +271,39 @@ void AudioStream::returnToPool()
 {
     assert(sample != nullptr);
 
+    auto& pool{ GlobalEngine::getInstance()->getAudioStreamPool() };
+
+    // Stop a pending refill. The worker may still be running or
+    // have the stream queued, so the buffer and the sample are kept
+    // until the pool sees the worker is done with it.
+    state = State::Idle;
+
+    pool.totalUnderruns += (uint64_t)underruns.load();
+    pool.returningStreams.append(this);
+}
+
+void AudioStream::recycle()
+{
     auto* g{ GlobalEngine::getInstance() };
+    auto& pool{ g->getAudioStreamPool() };
+
+    // The worker may have moved the state on while finishing its run
+    state = State::Idle;
+
+    pool.returnChunks(chunks.data(), numChunks);
+    numChunks = 0;
+    bufferSize = 0;
 
     // This moves the sample pointer so that we don't delete it here.
     g->releaseObject(sample);
-    g->getAudioStreamPool().returnToIdle(this);
+
+    if (residentLoop != nullptr)
+        g->releaseObject(std::move(residentLoop));
+
+    playingResidentLoop = false;
+    offset = 0;
+    loopBegin = -1;
+    loopEnd = -1;
 }
 
 void AudioStream::run()
@@ -209,30 +316,32 @@ void AudioStream::run()
     if (state == State::Init) {
         // Initializing stream
         assert(sample != nullptr);
-        file.reset(sample->getAudioFile().clone());
-
-        if (file == nullptr) {
-            state = State::Over;
-            return;
-        }
 
-        if (file->open().failed()) {
-            state = State::Over;
-            return;
-        }
+        // The file is opened on the first read that misses the cache
+        streamReader = {};
+        loopReader = {};
 
-        if (file->seek(sample->getStartPosition() + sample->getNumPreloadedFrames()).failed())
-        {
-            state = State::Finishing;
-            return;
-        }
+        residentLoop = nullptr;
+        residentLoopChecked = true;
+        playingResidentLoop = false;
+        decodingLoop = nullptr;
+        loopFramesDecoded = 0;
 
         // Generate x-fade envelope if looping
         if (loopBegin >=0 && loopEnd >= 0)
         {
-            xfadeBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, loopXfadeSize);
+            xfadeBuffer.allocate(numChannels, loopXfadeSize);
             xfadeEnvelope.allocate(2, loopXfadeSize);
             generateXfadeEnvelope(0.5f);
+
+            // Another stream may have the loop decoded already
+            auto& loopCache{ GlobalEngine::getInstance()->getLoopCache() };
+            const int loopLength{ loopEnd - loopBegin };
+
+            if (loopCache.isResidentSize(loopLength) && loopLength >= loopXfadeSize) {
+                residentLoop = loopCache.find(getLoopKey());
+                residentLoopChecked = residentLoop != nullptr;
+            }
         }
 
         state = State::Streaming;
@@ -242,11 +351,13 @@ void AudioStream::run()
     }
 
     if (state == State::Streaming) {
-        // Active streaming
-        int framesToRead{ buffer.getNumFrames() - samplesInBuffer };
+        // Active streaming. The buffer goes away if the stream
+        // is returned to the pool meanwhile.
+        const int size{ bufferSize };
+        int framesToRead{ size - samplesInBuffer };
 
-        while (framesToRead > 0) {
-            int readThisTime{ std::min(buffer.getNumFrames() - writeIndex, framesToRead) };
+        while (framesToRead > 0 && state == State::Streaming) {
+            int readThisTime{ std::min(getContiguousFrames(writeIndex), framesToRead) };
 
             bool loop{ false };
 
@@ -267,11 +378,11 @@ void AudioStream::run()
                 }
             }
 
-            float* left{ &buffer.getChannelData(0)[writeIndex] };
-            float* right{ &buffer.getChannelData(1)[writeIndex] };
+            float* left{ getBufferData(0, writeIndex) };
+            float* right{ numChannels > 1 ? getBufferData(1, writeIndex) : nullptr };
 
-            assert(file->isOpen());
-            const int framesRead = file->read(readThisTime, left, right);
+            const int framesRead = playingResidentLoop ? readFromLoop(streamPos - loopBegin, readThisTime, left, right)
+                                                       : readFrames(streamReader, streamPos, readThisTime, left, right);
 
             if (framesRead == 0) {
                 // Stream is depleted
@@ -286,25 +397,29 @@ void AudioStream::run()
                 const int n{ std::min(samplesInXfadeBuffer, framesRead) };
                 int j{ xfadeBuffer.getNumFrames() - samplesInXfadeBuffer };
 
-                for (int i = 0; i < n; ++i) {
-                    const auto a{ xfadeEnvelope.getChannelData(0)[j] };
-                    const auto b{ xfadeEnvelope.getChannelData(1)[j] };
-
-                    left[i] = left[i] * a + xfadeBuffer.getChannelData(0)[j] * b;
-                    right[i] = right[i] * a + xfadeBuffer.getChannelData(1)[j] * b;
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    float* dst{ ch == 0 ? left : right };
+                    const float* src{ xfadeBuffer.getChannelData(ch) };
+                    const float* a{ xfadeEnvelope.getChannelData(0) };
+                    const float* b{ xfadeEnvelope.getChannelData(1) };
 
-                    ++j;
+                    for (int i = 0; i < n; ++i)
+                        dst[i] = dst[i] * a[j + i] + src[j + i] * b[j + i];
                 }
 
                 samplesInXfadeBuffer -= n;
             }
 
-            writeIndex = (writeIndex.load() + framesRead) % buffer.getNumFrames();
+            writeIndex = (writeIndex.load() + framesRead) % size;
             framesToRead -= framesRead;
             samplesInBuffer += framesRead;
             streamPos += framesRead;
 
-            if (loop) {
+            if (loop && residentLoop != nullptr) {
+                // The cross-fade is baked into the decoded loop
+                streamPos = loopBegin;
+                playingResidentLoop = true;
+            } else if (loop) {
                 assert(samplesInXfadeBuffer == 0);
                 assert(streamPos == loopEnd);
 
@@ -317,9 +432,9 @@ void AudioStream::run()
                 int xfadeIdx{ 0 };
 
                 while (xfadeRead > 0) {
-                    const auto read{ file->read (xfadeRead,
-                                                 &xfadeBuffer.getChannelData(0)[xfadeIdx],
-                                                 &xfadeBuffer.getChannelData(1)[xfadeIdx]) };
+                    const auto read{ readFrames(streamReader, loopEnd + xfadeIdx, xfadeRead,
+                                                &xfadeBuffer.getChannelData(0)[xfadeIdx],
+                                                numChannels > 1 ? &xfadeBuffer.getChannelData(1)[xfadeIdx] : nullptr) };
 
                     if (read == 0)
                         break;
@@ -328,18 +443,32 @@ void AudioStream::run()
                     xfadeRead -= read;
                 }
 
-                file->seek(sample->getStartPosition() + loopBegin);
-
                 streamPos = loopBegin;
                 samplesInXfadeBuffer = xfadeBuffer.getNumFrames();
             }
         }
+
+        // Decode a part of the loop once the buffer is full, and
+        // come back for the next one after the more urgent jobs.
+        if (!residentLoopChecked && state == State::Streaming) {
+            decodeLoopPart();
+
+            if (!residentLoopChecked)
+                worker->addJob(this);
+        }
     }
 
+    // Measure the time it took to serve the refill request
+    if (const auto requestTime{ refillRequestTime.exchange(0) }; requestTime != 0)
+        GlobalEngine::getInstance()->getAudioStreamPool().updateRefillLatency(toSeconds(now() - requestTime));
+
     if (state == State::Finishing) {
         // Close file on streaming thread
-        if (file != nullptr && file->isOpen())
-            file->close();
+        if (streamReader.file != nullptr && streamReader.file->isOpen())
+            streamReader.file->close();
+
+        loopReader = {};
+        decodingLoop = nullptr;
 
         if (samplesInBuffer == 0)
             state = State::Over;
@@ -347,10 +476,62 @@ void AudioStream::run()
 
     if (state == State::Over) {
         // Reset file as stream will be returned to pool
-        file.reset();
+        streamReader = {};
     }
 }
 
+void AudioStream::waitForFrames(int numFrames)
+{
+    numFrames = std::min(numFrames, bufferSize);
+
+    while (samplesInBuffer < numFrames && (state == State::Init || state == State::Streaming)) {
+        worker->addJob(this);
+        std::this_thread::yield();
+    }
+}
+
+int AudioStream::getSlack() const
+{
+    // Predicted time to empty the buffer, in microseconds
+    const float t{ (float)samplesInBuffer.load() / playbackRate.load() };
+    return (int)std::min(1e9f, t * 1e6f);
+}
+
+bool AudioStream::needsRefill() const noexcept
+{
+    if (state != State::Streaming)
+        return false;
+
+    const int framesInBuffer{ samplesInBuffer };
+
+    if (framesInBuffer <= bufferSize / 2)
+        return true;
+
+    // Refill earlier if the buffer is about to be consumed faster
+    // than a refill request is usually served.
+    auto& pool{ GlobalEngine::getInstance()->getAudioStreamPool() };
+    const float timeToEmpty{ (float)framesInBuffer / playbackRate.load() };
+
+    return bufferSize - framesInBuffer >= chunkFrames / 4
+        && timeToEmpty < STREAM_REFILL_LATENCY_MARGIN * pool.getRefillLatency();
+}
+
+void AudioStream::requestRefill()
+{
+    int64_t expected{ 0 };
+    refillRequestTime.compare_exchange_strong(expected, now());
+
+    worker->addJob(this);
+}
+
+float* AudioStream::getBufferData(int channel, int index) const noexcept
+{
+    assert(index >= 0 && index < bufferSize);
+    assert(channel < numChannels);
+
+    return chunks[(size_t)(index / chunkFrames)] + channel * STREAM_BUFFER_CHUNK_SIZE + index % chunkFrames;
+}
+
 void AudioStream::close()
 {
     if (sample != nullptr)
@@ -359,6 +540,206 @@ void AudioStream::close()
     state = State::Over;
 }
 
+int AudioStream::readFrames(FileReader& reader, int pos, int numFrames, float* left, float* right)
+{
+    auto& cache{ GlobalEngine::getInstance()->getBlockCache() };
+
+    if (!cache.isEnabled())
+        return readFromFile(reader, pos, numFrames, left, right);
+
+    int framesRead{ 0 };
+
+    while (framesRead < numFrames) {
+        const int index{ pos / CACHE_BLOCK_SIZE };
+        const int blockOffset{ pos % CACHE_BLOCK_SIZE };
+
+        auto block{ cache.find(sample->getHash(), index) };
+
+        if (block == nullptr) {
+            block = decodeBlock(reader, index);
+
+            if (block == nullptr)
+                break;
+
+            block = cache.insert(sample->getHash(), index, block);
+        }
+
+        const int n{ std::min(block->numFrames - blockOffset, numFrames - framesRead) };
+
+        if (n <= 0)
+            break;
+
+        ::memcpy(&left[framesRead], &block->buffer.getChannelData(0)[blockOffset], sizeof(float) * n);
+
+        if (numChannels > 1)
+            ::memcpy(&right[framesRead], &block->buffer.getChannelData(1)[blockOffset], sizeof(float) * n);
+
+        framesRead += n;
+        pos += n;
+    }
+
+    return framesRead;
+}
+
+int AudioStream::readFromFile(FileReader& reader, int pos, int numFrames, float* left, float* right)
+{
+    if (!openFile(reader))
+        return 0;
+
+    auto& file{ *reader.file };
+
+    if (pos != reader.pos) {
+        if (file.seek(sample->getStartPosition() + pos).failed())
+            return 0;
+
+        reader.pos = pos;
+    }
+
+    const int framesRead{ file.read(numFrames, left, right) };
+    reader.pos += framesRead;
+
+    // Let the OS fetch the next chunk in the background while
+    // the current one is being consumed.
+    if (framesRead > 0)
+        file.prefetch(sample->getStartPosition() + reader.pos, numFrames);
+
+    return framesRead;
+}
+
+BlockCache::BlockPtr AudioStream::decodeBlock(FileReader& reader, int index)
+{
+    const int pos{ index * CACHE_BLOCK_SIZE };
+    int numFrames{ CACHE_BLOCK_SIZE };
+
+    if (sample->getStopPosition() > 0)
+        numFrames = std::min(numFrames, sample->getStopPosition() - sample->getStartPosition() - pos);
+
+    if (numFrames <= 0)
+        return nullptr;
+
+    auto block{ std::make_shared<BlockCache::Block>(numChannels) };
+    block->numFrames = readFromFile(reader, pos, numFrames, block->buffer.getChannelData(0),
+                                    numChannels > 1 ? block->buffer.getChannelData(1) : nullptr);
+
+    if (block->numFrames <= 0)
+        return nullptr;
+
+    return block;
+}
+
+void AudioStream::decodeLoopPart()
+{
+    auto& loopCache{ GlobalEngine::getInstance()->getLoopCache() };
+
+    // Another stream may have published the loop meanwhile
+    if (auto loop{ loopCache.find(getLoopKey()) }) {
+        residentLoop = std::move(loop);
+        residentLoopChecked = true;
+        decodingLoop = nullptr;
+        loopReader = {};
+        return;
+    }
+
+    const int loopLength{ loopEnd - loopBegin };
+
+    if (decodingLoop == nullptr) {
+        decodingLoop = std::make_shared<LoopCache::Loop>(numChannels, loopLength);
+        loopFramesDecoded = 0;
+    }
+
+    auto& buffer{ decodingLoop->buffer };
+
+    const auto read = [this](int pos, int numFrames, core::AudioBuffer<float>& dst, int dstPos) {
+        int framesRead{ 0 };
+
+        while (framesRead < numFrames) {
+            const auto n{ readFrames(loopReader, pos + framesRead, numFrames - framesRead,
+                                     &dst.getChannelData(0)[dstPos + framesRead],
+                                     numChannels > 1 ? &dst.getChannelData(1)[dstPos + framesRead] : nullptr) };
+
+            if (n == 0)
+                break;
+
+            framesRead += n;
+        }
+
+        return framesRead;
+    };
+
+    const int numFrames{ std::min(loopDecodeBlockSize, loopLength - loopFramesDecoded) };
+
+    if (read(loopBegin + loopFramesDecoded, numFrames, buffer, loopFramesDecoded) < numFrames) {
+        // The loop cannot be resident, keep streaming it from the file
+        residentLoopChecked = true;
+        decodingLoop = nullptr;
+        loopReader = {};
+        return;
+    }
+
+    loopFramesDecoded += numFrames;
+
+    if (loopFramesDecoded < loopLength)
+        return;
+
+    // Mix the frames following the loop end into the loop start,
+    // as the streaming does on each loop cycle.
+    core::AudioBuffer<float> tail(numChannels, loopXfadeSize);
+    tail.clear();
+    read(loopEnd, loopXfadeSize, tail, 0);
+
+    const float* a{ xfadeEnvelope.getChannelData(0) };
+    const float* b{ xfadeEnvelope.getChannelData(1) };
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        float* dst{ buffer.getChannelData(ch) };
+        const float* src{ tail.getChannelData(ch) };
+
+        for (int i = 0; i < loopXfadeSize; ++i)
+            dst[i] = dst[i] * a[i] + src[i] * b[i];
+    }
+
+    residentLoop = loopCache.insert(getLoopKey(), std::move(decodingLoop));
+    residentLoopChecked = true;
+    decodingLoop = nullptr;
+    loopReader = {};
+}
+
+LoopCache::Key AudioStream::getLoopKey() const noexcept
+{
+    return { sample->getHash(), loopBegin, loopEnd, loopXfadeSize };
+}
+
+int AudioStream::readFromLoop(int pos, int numFrames, float* left, float* right)
+{
+    assert(residentLoop != nullptr);
+
+    const auto& buffer{ residentLoop->buffer };
+    const int n{ std::min(numFrames, buffer.getNumFrames() - pos) };
+
+    ::memcpy(left, &buffer.getChannelData(0)[pos], sizeof(float) * n);
+
+    if (numChannels > 1)
+        ::memcpy(right, &buffer.getChannelData(1)[pos], sizeof(float) * n);
+
+    return n;
+}
+
+bool AudioStream::openFile(FileReader& reader)
+{
+    if (reader.file != nullptr && reader.file->isOpen())
+        return true;
+
+    reader.file.reset(sample->getAudioFile().clone());
+    reader.pos = -1;
+
+    if (reader.file->open().failed()) {
+        reader.file.reset();
+        return false;
+    }
+
+    return true;
+}
+
 void AudioStream::generateXfadeEnvelope(float k)
 {
     const float r{ 1.0f / (float)xfadeEnvelope.getNumFrames() };
@@ -377,19 +758,35 @@ void AudioStream::generateXfadeEnvelope(float k)
 
 //==============================================================================
 
-AudioStreamPool::AudioStreamPool(int numStreams)
-    : streams(numStreams) // This will create streams with default buffer size
+AudioStreamPool::AudioStreamPool(int numStreams, int numBufferChunks)
+    : streams(numStreams)
+    , totalUnderruns{ 0 }
+    , numIdleStreams{ 0 }
+    , chunksMemory(1, std::max(numBufferChunks, numStreams * MIN_STREAM_BUFFER_CHUNKS) * STREAM_BUFFER_CHUNK_SIZE * MIX_BUFFER_NUM_CHANNELS)
+    , refillLatency{ 0.005f }
 {
-    for (auto& stream : streams)
+    const int numChunks{ chunksMemory.getNumFrames() / (STREAM_BUFFER_CHUNK_SIZE * MIX_BUFFER_NUM_CHANNELS) };
+    freeChunks.reserve((size_t)numChunks);
+
+    for (int i = numChunks; --i >= 0;)
+        freeChunks.push_back(chunksMemory.data() + (size_t)i * STREAM_BUFFER_CHUNK_SIZE * MIX_BUFFER_NUM_CHANNELS);
+
+    for (auto& stream : streams) {
         idleStreams.append(&stream);
+        ++numIdleStreams;
+    }
 }
 
 AudioStreamPool::~AudioStreamPool() = default;
 
 AudioStream* AudioStreamPool::getStream()
 {
+    if (idleStreams.isEmpty())
+        recycleStreams();
+
     if (auto* stream{ idleStreams.first() }) {
         idleStreams.remove(stream);
+        --numIdleStreams;
         return stream;
     }
 
@@ -400,6 +797,55 @@ void AudioStreamPool::returnToIdle(AudioStream* stream)
 {
     assert(stream != nullptr);
     idleStreams.append(stream);
+    ++numIdleStreams;
+}
+
+void AudioStreamPool::recycleStreams(bool wait)
+{
+    auto* stream{ returningStreams.first() };
+
+    while (stream != nullptr) {
+        if (stream->isBusy()) {
+            if (wait)
+                std::this_thread::yield();
+            else
+                stream = stream->next();
+
+            continue;
+        }
+
+        auto* nextStream{ returningStreams.removeAndReturnNext(stream) };
+        stream->recycle();
+        returnToIdle(stream);
+        stream = nextStream;
+    }
+}
+
+int AudioStreamPool::takeChunks(float** chunks, int numChunks)
+{
+    // Every idle stream must still be able to get its minimum
+    const int available{ (int)freeChunks.size() - numIdleStreams * MIN_STREAM_BUFFER_CHUNKS };
+    const int n{ std::clamp(available, std::min(MIN_STREAM_BUFFER_CHUNKS, (int)freeChunks.size()), numChunks) };
+
+    for (int i = 0; i < n; ++i) {
+        chunks[i] = freeChunks.back();
+        freeChunks.pop_back();
+    }
+
+    return n;
+}
+
+void AudioStreamPool::returnChunks(float* const* chunks, int numChunks)
+{
+    for (int i = 0; i < numChunks; ++i)
+        freeChunks.push_back(chunks[i]);
+}
+
+void AudioStreamPool::updateRefillLatency(float latency) noexcept
+{
+    // Exponential moving average, concurrent updates may be lost
+    const float avg{ refillLatency.load(std::memory_order_relaxed) };
+    refillLatency.store(avg + 0.05f * (latency - avg), std::memory_order_relaxed);
 }
 
 TW_NAMESPACE_END
@@ -11,14 +11,26 @@
 #include "globals.h"
 #include "sample.h"
 #include "audio_file.h"
+#include "block_cache.h"
+#include "loop_cache.h"
 #include "core/list.h"
 #include "core/worker.h"
 #include "core/audio_buffer.h"
+#include <array>
 #include <vector>
 #include <atomic>
+#include <cstdint>
 
 TW_NAMESPACE_BEGIN
 
+/**
+ * Streams a sample from its file (or the blocks cache) after its preloaded frames.
+ *
+ * The streaming buffer is a ring of chunks taken from the stream pool when
+ * the stream is triggered. Its size follows the stream's playback rate and
+ * the measured refill latency, and refills are requested from the predicted
+ * time to empty the buffer.
+ */
 class AudioStream final : public core::ListItem<AudioStream>,
                           public core::Worker::Job
 {
@@ -34,43 +46,154 @@ public:
         Over
     };
 
-    AudioStream(int bufferSize = DEFAULT_STREAM_BUFFER_SIZE);
+    AudioStream();
     AudioStream(const AudioStream&) = delete;
     AudioStream& operator =(const AudioStream&) = delete;
     ~AudioStream();
 
-    void trigger(Sample::Ptr streamingSample, core::Worker* streamingWorker);
+    /**
+     * Start streaming a sample.
+     * A blocking stream waits for the worker instead of underrunning,
+     * which is used for the non-realtime rendering.
+     *
+     * @param playbackRate Expected consumption rate in source frames per second.
+     */
+    void trigger(Sample::Ptr streamingSample, core::Worker* streamingWorker, bool blockingStream = false,
+                 float playbackRate = DEFAULT_SAMPLE_RATE_F);
+
+    /**
+     * Update the consumption rate (source frames per second)
+     * used to predict when the buffer runs out.
+     */
+    void setPlaybackRate(float rate) noexcept { playbackRate = rate; }
+
+    /**
+     * Returns the streaming buffer capacity in frames.
+     */
+    int getBufferSize() const noexcept { return bufferSize; }
     Sample::Ptr getSample() noexcept { return sample; }
     float getSampleRate();
 
+    /**
+     * Set the loop and the start offset, before the stream is triggered.
+     */
     void setLoop(int begin, int end, int xfade);
     void setOffset(int offs);
 
+    /**
+     * Returns the number of channels delivered by the stream.
+     * Mono streams only fill the left channel.
+     */
+    int getNumChannels() const noexcept { return numChannels; }
+
+    /**
+     * Read frames from the stream.
+     * For mono streams only the left channel is written, right may be nullptr.
+     */
     int fillBuffers(float* left, float* right, int nFrames);
     bool readOne(float& left, float& right);
 
     bool isOver() const noexcept { return state == State::Over; }
 
+    /**
+     * Returns the number of times the stream has failed to deliver
+     * the requested frames since it was triggered.
+     */
+    int getNumUnderruns() const noexcept { return underruns; }
+
     void release();
+
+    /**
+     * Hand the stream back to the pool. Its buffer is recycled
+     * once the worker is done with the stream.
+     */
     void returnToPool();
 
     // Worker::Job
     void run() override;
+    int getSlack() const override;
 
 private:
+
+    friend class AudioStreamPool;
+
+    /**
+     * Return the buffer chunks and release the sample,
+     * once the worker cannot access them anymore.
+     */
+    void recycle();
+
     void close();
+
+    /**
+     * Tells whether the buffer should be refilled, based
+     * on the predicted time to empty it.
+     */
+    bool needsRefill() const noexcept;
+    void requestRefill();
+
+    /**
+     * Returns the streaming buffer data for a channel at a given index,
+     * and the number of frames that are contiguous from there.
+     */
+    float* getBufferData(int channel, int index) const noexcept;
+    int getContiguousFrames(int index) const noexcept { return chunkFrames - index % chunkFrames; }
+
+    /**
+     * Wait for the worker to fill the streaming buffer (blocking streams only).
+     */
+    void waitForFrames(int numFrames);
+
     void generateXfadeEnvelope(float k = 1.0f);
 
+    /**
+     * Audio file opened on the first read that misses the cache,
+     * with its read position within the sample (-1 if unknown).
+     */
+    struct FileReader
+    {
+        std::unique_ptr<AudioFile> file{};
+        int pos{ -1 };
+    };
+
+    /**
+     * Read frames at a given position within the sample,
+     * through the blocks cache if it is enabled.
+     */
+    int readFrames(FileReader& reader, int pos, int numFrames, float* left, float* right);
+    int readFromFile(FileReader& reader, int pos, int numFrames, float* left, float* right);
+    BlockCache::BlockPtr decodeBlock(FileReader& reader, int index);
+    bool openFile(FileReader& reader);
+
+    /**
+     * Decode the next part of the loop region. Once complete, the loop
+     * gets its cross-fade and is shared via the loops cache.
+     *
+     * The loop is decoded over successive runs, so that the other
+     * streams served by the worker are refilled meanwhile.
+     */
+    void decodeLoopPart();
+    LoopCache::Key getLoopKey() const noexcept;
+    int readFromLoop(int pos, int numFrames, float* left, float* right);
+
     std::atomic<State> state;
 
     Sample::Ptr sample;
     core::Worker* worker;
+    bool blocking;                          ///< Wait for the data instead of underrunning.
 
-    core::AudioBuffer<float> buffer;        ///< Streaming buffer.
+    std::array<float*, MAX_STREAM_BUFFER_CHUNKS> chunks;   ///< Streaming buffer chunks.
+    int numChunks;
+    int chunkFrames;                        ///< Frames per chunk, mono streams use both halves of a chunk.
+    int bufferSize;                         ///< Streaming buffer capacity in frames.
+    int numChannels;                        ///< Streamed sample channels.
+    std::atomic<float> playbackRate;        ///< Source frames consumed per second.
+    std::atomic<int64_t> refillRequestTime; ///< Time of the pending refill request, zero if none.
     core::AudioBuffer<float> xfadeBuffer;   ///< Loop cross-fade buffer.
     core::AudioBuffer<float> xfadeEnvelope; ///< Cross-fade amplitude envelope.
 
     std::atomic<int> samplesInBuffer;       ///< Number of samples in the streaming buffer.
+    std::atomic<int> underruns;             ///< Number of buffer underruns.
     int samplesInXfadeBuffer;               ///< Number of samples in the loop cross-fade buffer.
     std::atomic<int> readIndex;             ///< Read position within the streaming buffer.
     std::atomic<int> writeIndex;            ///< Write position within the streaming buffer.
@@ -82,28 +205,85 @@ private:
     int loopEnd;
     int loopXfadeSize;
 
-    std::unique_ptr<AudioFile> file;    ///< Audio file to stream from.
+    LoopCache::LoopPtr residentLoop;    ///< Decoded loop, if short enough.
+    bool residentLoopChecked;           ///< The loop has been looked up or decoded.
+    bool playingResidentLoop;           ///< Streaming from the decoded loop.
+    LoopCache::LoopPtr decodingLoop;    ///< Loop being decoded.
+    int loopFramesDecoded;              ///< Frames of the loop decoded so far.
+
+    FileReader streamReader;            ///< File to stream from.
+    FileReader loopReader;              ///< File to decode the loop from, not to seek the streaming one.
 };
 
 //==============================================================================
 
 /**
  * A collection of streams.
+ *
+ * The pool also owns the memory of the streaming buffers, split into
+ * chunks that are handed to the streams when they are triggered.
  */
 class AudioStreamPool final
 {
 public:
-    AudioStreamPool(int numStreams = DEFAULT_AUDIO_STREAM_POOL_SIZE);
+    AudioStreamPool(int numStreams = DEFAULT_AUDIO_STREAM_POOL_SIZE, int numBufferChunks = DEFAULT_STREAM_BUFFER_POOL_SIZE);
     AudioStreamPool(const AudioStreamPool&) = delete;
     AudioStreamPool& operator =(const AudioStreamPool&) = delete;
     ~AudioStreamPool();
 
     AudioStream* getStream();
     void returnToIdle(AudioStream* stream);
+    bool hasIdleStreams() const noexcept { return !idleStreams.isEmpty(); }
+    int getNumIdleStreams() const noexcept { return numIdleStreams; }
+    int getSize() const noexcept { return (int)streams.size(); }
+
+    /**
+     * Move the returned streams the workers are done with back to idle.
+     * This must be called on the audio thread.
+     *
+     * @param wait Wait for the workers to be done with all the returned streams.
+     */
+    void recycleStreams(bool wait = false);
+
+    /**
+     * Returns the total number of underruns of the streams
+     * that have been returned to the pool.
+     */
+    uint64_t getNumUnderruns() const noexcept { return totalUnderruns; }
+    void resetUnderruns() noexcept { totalUnderruns = 0; }
+
+    /**
+     * Returns the average time (in seconds) between a refill
+     * request and its completion.
+     */
+    float getRefillLatency() const noexcept { return refillLatency; }
+
+    int getNumFreeChunks() const noexcept { return (int)freeChunks.size(); }
 
 private:
+
+    friend class AudioStream;
+
+    /**
+     * Take up to numChunks buffer chunks, keeping enough of them
+     * for the idle streams.
+     *
+     * @returns the number of chunks taken.
+     */
+    int takeChunks(float** chunks, int numChunks);
+    void returnChunks(float* const* chunks, int numChunks);
+
+    void updateRefillLatency(float latency) noexcept;
+
     std::vector<AudioStream> streams;
+    std::atomic<uint64_t> totalUnderruns;
     core::List<AudioStream> idleStreams;
+    core::List<AudioStream> returningStreams;  ///< Returned streams that may still be used by a worker.
+    int numIdleStreams;
+
+    core::AudioBuffer<float> chunksMemory;
+    std::vector<float*> freeChunks;
+    std::atomic<float> refillLatency;
 };
 
 TW_NAMESPACE_END
@@ -0,0 +1,141 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "block_cache.h"
+#include <cassert>
+
+TW_NAMESPACE_BEGIN
+
+BlockCache::BlockCache(size_t capacityInBytes)
+    : capacity{ 0 }
+    , size{ 0 }
+    , clockHand{ 0 }
+    , hits{ 0 }
+    , misses{ 0 }
+    , evictions{ 0 }
+{
+    setCapacity(capacityInBytes);
+}
+
+void BlockCache::setCapacity(size_t capacityInBytes)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    slotIndex.clear();
+    slots.clear();
+    freeSlots.clear();
+    size = 0;
+    clockHand = 0;
+    capacity = capacityInBytes;
+}
+
+size_t BlockCache::getCapacity() const
+{
+    return capacity;
+}
+
+BlockCache::BlockPtr BlockCache::find(std::size_t sampleHash, int blockIndex)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (auto it{ slotIndex.find({ sampleHash, blockIndex }) }; it != slotIndex.end()) {
+        auto& slot{ slots[it->second] };
+        slot.referenced = true;
+        ++hits;
+        return slot.block;
+    }
+
+    ++misses;
+    return nullptr;
+}
+
+BlockCache::BlockPtr BlockCache::insert(std::size_t sampleHash, int blockIndex, BlockPtr block)
+{
+    assert(block != nullptr);
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    const size_t blockSize{ block->getSizeInBytes() };
+
+    if (blockSize > capacity)
+        return block;
+
+    const Key key{ sampleHash, blockIndex };
+
+    if (auto it{ slotIndex.find(key) }; it != slotIndex.end())
+        return slots[it->second].block;
+
+    while (size + blockSize > capacity)
+        evict();
+
+    size_t idx{ slots.size() };
+
+    if (freeSlots.empty()) {
+        slots.emplace_back();
+    } else {
+        idx = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    auto& slot{ slots[idx] };
+    slot.key = key;
+    slot.block = block;
+    slot.referenced = false;
+    slotIndex[key] = idx;
+    size += blockSize;
+
+    return block;
+}
+
+void BlockCache::clear()
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    slotIndex.clear();
+    slots.clear();
+    freeSlots.clear();
+    size = 0;
+    clockHand = 0;
+}
+
+BlockCache::Stats BlockCache::getStats() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    return { hits, misses, evictions, slotIndex.size(), size, capacity };
+}
+
+void BlockCache::resetStats()
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+void BlockCache::evict()
+{
+    assert(!slotIndex.empty());
+
+    // Give a second chance to the recently used blocks, skip the free slots
+    while (slots[clockHand].block == nullptr || slots[clockHand].referenced) {
+        slots[clockHand].referenced = false;
+        clockHand = (clockHand + 1) % slots.size();
+    }
+
+    const size_t idx{ clockHand };
+    clockHand = (clockHand + 1) % slots.size();
+
+    auto& slot{ slots[idx] };
+    size -= slot.block->getSizeInBytes();
+    slotIndex.erase(slot.key);
+    slot.block.reset();
+    freeSlots.push_back(idx);
+    ++evictions;
+}
+
+TW_NAMESPACE_END
@@ -0,0 +1,134 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "globals.h"
+#include "core/audio_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+TW_NAMESPACE_BEGIN
+
+/**
+ * Cache of decoded sample blocks.
+ *
+ * Samples are split into blocks of CACHE_BLOCK_SIZE frames, counted from
+ * the sample's start position. The decoded blocks are shared between all
+ * the streams playing the same sample, so that repeated notes and loops
+ * are served from memory instead of being decoded again.
+ *
+ * The cache is bounded by a memory budget and uses the CLOCK
+ * (second chance) eviction policy. It is accessed by the streaming
+ * threads only, never by the audio thread.
+ */
+class BlockCache final
+{
+public:
+
+    /**
+     * Decoded block of samples.
+     * Mono samples are cached as single channel blocks.
+     */
+    struct Block
+    {
+        explicit Block(int numChannels = MIX_BUFFER_NUM_CHANNELS) : buffer{ numChannels, CACHE_BLOCK_SIZE } {}
+
+        size_t getSizeInBytes() const noexcept { return sizeof(float) * (size_t)buffer.getNumChannels() * CACHE_BLOCK_SIZE; }
+
+        core::AudioBuffer<float> buffer;
+        int numFrames{ 0 };     ///< Valid frames, may be less than the block size at the sample end.
+    };
+
+    using BlockPtr = std::shared_ptr<const Block>;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t numBlocks;
+        size_t size;        ///< Cached blocks size in bytes.
+        size_t capacity;    ///< Cache capacity in bytes.
+    };
+
+    /// Size of a stereo block.
+    constexpr static size_t blockSizeInBytes{ sizeof(float) * MIX_BUFFER_NUM_CHANNELS * CACHE_BLOCK_SIZE };
+
+    explicit BlockCache(size_t capacityInBytes = DEFAULT_BLOCK_CACHE_SIZE);
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator =(const BlockCache&) = delete;
+
+    /**
+     * Set the cache memory budget.
+     * This will drop all the cached blocks. Zero capacity disables the cache.
+     */
+    void setCapacity(size_t capacityInBytes);
+    size_t getCapacity() const;
+
+    bool isEnabled() const noexcept { return capacity > 0; }
+
+    /**
+     * Look up a block. Returns nullptr on miss.
+     */
+    BlockPtr find(std::size_t sampleHash, int blockIndex);
+
+    /**
+     * Put a decoded block into the cache.
+     * If the block is already there (decoded concurrently by another
+     * stream) the cached one is kept and returned.
+     */
+    BlockPtr insert(std::size_t sampleHash, int blockIndex, BlockPtr block);
+
+    void clear();
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+
+    struct Key
+    {
+        std::size_t hash;
+        int index;
+
+        bool operator ==(const Key& other) const noexcept { return hash == other.hash && index == other.index; }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const noexcept { return key.hash ^ ((std::size_t)key.index * 0x9E3779B97F4A7C15ull); }
+    };
+
+    struct Slot
+    {
+        Key key{};
+        BlockPtr block{};
+        bool referenced{ false };
+    };
+
+    void evict();
+
+    mutable std::mutex mutex;
+    std::unordered_map<Key, size_t, KeyHash> slotIndex;
+    std::vector<Slot> slots;
+    std::vector<size_t> freeSlots;  ///< Slots released by evicted blocks.
+    std::atomic<size_t> capacity;   ///< Memory budget in bytes.
+    size_t size;                    ///< Cached blocks size in bytes.
+    size_t clockHand;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+};
+
+TW_NAMESPACE_END
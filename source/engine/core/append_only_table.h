@@ -0,0 +1,112 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Append-only table with wait-free lookups.
+ *
+ * Items are stored in fixed-size segments that are never moved or freed
+ * while the table is alive, and an item is never modified once it has been
+ * published. Readers only load the number of published items and the
+ * segment pointer, so they never block on a writer.
+ *
+ * @note Appending is not thread-safe, the writers must be serialized.
+ */
+template <typename T, size_t SegmentSize = 256, size_t MaxSegments = 1024>
+class AppendOnlyTable final
+{
+public:
+
+    AppendOnlyTable() noexcept
+        : numItems{ 0 }
+    {
+        for (auto& segment : segments)
+            segment.store(nullptr, std::memory_order_relaxed);
+    }
+
+    AppendOnlyTable(const AppendOnlyTable&) = delete;
+    AppendOnlyTable& operator =(const AppendOnlyTable&) = delete;
+
+    ~AppendOnlyTable()
+    {
+        for (auto& segment : segments)
+            delete segment.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Append an item to the table.
+     *
+     * @returns the item's index or -1 if the table is full.
+     */
+    int append(const T& item)
+    {
+        const int index{ numItems.load(std::memory_order_relaxed) };
+        const size_t segmentIndex{ (size_t)index / SegmentSize };
+
+        if (segmentIndex >= MaxSegments)
+            return -1;
+
+        auto* segment{ segments[segmentIndex].load(std::memory_order_relaxed) };
+
+        if (segment == nullptr) {
+            segment = new Segment();
+            segments[segmentIndex].store(segment, std::memory_order_relaxed);
+        }
+
+        segment->items[(size_t)index % SegmentSize] = item;
+
+        // Publish the item (and the segment) to the readers
+        numItems.store(index + 1, std::memory_order_release);
+
+        return index;
+    }
+
+    /**
+     * Returns an item by its index or nullptr if there is no such item.
+     * This is wait-free and can be called from the audio thread.
+     */
+    const T* get(int index) const noexcept
+    {
+        if (index < 0 || index >= numItems.load(std::memory_order_acquire))
+            return nullptr;
+
+        const auto* segment{ segments[(size_t)index / SegmentSize].load(std::memory_order_relaxed) };
+        assert(segment != nullptr);
+
+        return &segment->items[(size_t)index % SegmentSize];
+    }
+
+    int size() const noexcept { return numItems.load(std::memory_order_acquire); }
+
+    constexpr static size_t capacity() noexcept { return SegmentSize * MaxSegments; }
+
+private:
+
+    struct Segment
+    {
+        std::array<T, SegmentSize> items{};
+    };
+
+    std::array<std::atomic<Segment*>, MaxSegments> segments;
+    std::atomic<int> numItems;
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -96,6 +96,17 @@ public:
         ::memset(dataPtr, 0, sizeof(SampleType) * nChannels * nFrames);
     }
 
+    /**
+     * Clear the first numFrames of each channel.
+     */
+    void clear(int numFrames)
+    {
+        assert(numFrames <= nFrames);
+
+        for (int ch = 0; ch < nChannels; ++ch)
+            ::memset(getChannelData(ch), 0, sizeof(SampleType) * numFrames);
+    }
+
     void fill(SampleType value)
     {
         assert(dataPtr != nullptr);
@@ -122,6 +133,23 @@ public:
             dataPtr[i] += other.dataPtr[i] * gain;
     }
 
+    /**
+     * Mix the first numFrames of each channel of another buffer.
+     */
+    void mix(const AudioBuffer<SampleType>& other, int numFrames)
+    {
+        assert(other.nChannels == nChannels);
+        assert(numFrames <= nFrames && numFrames <= other.nFrames);
+
+        for (int ch = 0; ch < nChannels; ++ch) {
+            SampleType* dst{ getChannelData(ch) };
+            const SampleType* src{ other.getChannelData(ch) };
+
+            for (int i = 0; i < numFrames; ++i)
+                dst[i] += src[i];
+        }
+    }
+
 private:
     int nChannels;
     int nFrames;
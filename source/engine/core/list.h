@@ -16,8 +16,15 @@ TW_NAMESPACE_BEGIN
 
 namespace core {
 
-template <class Item> struct ListItem;
-template <class Item> struct List;
+/**
+ * Tag used by default for the intrusive lists.
+ * An item can belong to several lists at once by inheriting
+ * from ListItem<> with different tags.
+ */
+struct DefaultListTag {};
+
+template <class Item, class Tag = DefaultListTag> struct ListItem;
+template <class Item, class Tag = DefaultListTag> struct List;
 
 template <typename Item>
 struct ListNode
@@ -26,18 +33,22 @@ private:
     Item* _prev{ nullptr };
     Item* _next{ nullptr };
 
-    template <typename I> friend struct ListItem;
-    template <typename I> friend struct List;
+    template <typename I, typename T> friend struct ListItem;
+    template <typename I, typename T> friend struct List;
 };
 
-template <class Item>
-struct ListItem : public ListNode<ListItem<Item>>
+template <class Item, class Tag>
+struct ListItem : public ListNode<ListItem<Item, Tag>>
 {
     void appendAfter(ListItem* item) noexcept
     {
         assert(item != nullptr);
         this->_prev = item;
         this->_next = item->_next;
+
+        if (item->_next != nullptr)
+            item->_next->_prev = this;
+
         item->_next = this;
     }
 
@@ -54,13 +65,17 @@ struct ListItem : public ListNode<ListItem<Item>>
 
     Item* next() noexcept { return static_cast<Item*>(this->_next); }
     Item* prev() noexcept { return static_cast<Item*>(this->_prev); }
+    const Item* next() const noexcept { return static_cast<const Item*>(this->_next); }
+    const Item* prev() const noexcept { return static_cast<const Item*>(this->_prev); }
 };
 
-template <class Item>
+template <class Item, class Tag>
 struct List
 {
     Item* first() noexcept { return _head; }
     Item* last() noexcept { return _tail; }
+    const Item* first() const noexcept { return _head; }
+    const Item* last() const noexcept { return _tail; }
 
     void append(Item* item) noexcept
     {
@@ -70,7 +85,7 @@ struct List
             _head = item;
             _tail = item;
         } else {
-            item->appendAfter(_tail);
+            base(item)->appendAfter(base(_tail));
             _tail = item;
         }
     }
@@ -79,7 +94,11 @@ struct List
     {
         assert(item != nullptr);
 
-        item->_next = _head;
+        base(item)->_next = base(_head);
+
+        if (_head != nullptr)
+            base(_head)->_prev = base(item);
+
         _head = item;
 
         if (_tail == nullptr)
@@ -91,23 +110,23 @@ struct List
         assert(item != nullptr);
 
         if (_head == item)
-            _head = item->next();
+            _head = base(item)->next();
 
         if (_tail == item)
-            _tail = item->prev();
+            _tail = base(item)->prev();
 
-        item->remove();
+        base(item)->remove();
     }
 
     bool contains(Item* item) const noexcept
     {
-        auto* it{ _head };
+        const Item* it{ _head };
 
         while (it != nullptr) {
             if (it == item)
                 return true;
 
-            it = it->next();
+            it = base(it)->next();
         }
 
         return false;
@@ -115,7 +134,7 @@ struct List
 
     Item* removeAndReturnNext(Item* item) noexcept
     {
-        Item* nextItem{ item->next() };
+        Item* nextItem{ base(item)->next() };
         remove(item);
         return nextItem;
     }
@@ -132,7 +151,7 @@ struct List
         if (index >= 0) {
             while (index > 0 && it != nullptr) {
                 --index;
-                it = it->next();
+                it = base(it)->next();
             }
         } else {
             it = _tail;
@@ -140,7 +159,7 @@ struct List
 
             while (index < 0 && it != nullptr) {
                 ++index;
-                it = it->prev();
+                it = base(it)->prev();
             }
         }
 
@@ -148,9 +167,12 @@ struct List
     }
 
 private:
-    using ItemBase = ListItem<Item>;
+    using ItemBase = ListItem<Item, Tag>;
     static_assert(std::derived_from<Item, ItemBase>, "List item must inherit from ListItem<>");
 
+    static ItemBase* base(Item* item) noexcept { return static_cast<ItemBase*>(item); }
+    static const ItemBase* base(const Item* item) noexcept { return static_cast<const ItemBase*>(item); }
+
     Item* _head{ nullptr };
     Item* _tail{ nullptr };
 };
@@ -0,0 +1,215 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "mapped_file.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+namespace {
+
+struct Registry
+{
+    std::mutex mutex;
+    std::unordered_map<std::string, MappedFile::Ptr> files;
+};
+
+Registry& getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+} // anonymous namespace
+
+MappedFile::MappedFile(const std::string& filePath)
+    : path{ filePath }
+{
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+MappedFile::Ptr MappedFile::open(const std::string& path)
+{
+    auto& registry{ getRegistry() };
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    if (auto it{ registry.files.find(path) }; it != registry.files.end())
+        return it->second;
+
+    Ptr file{ new MappedFile(path) };
+
+    if (!file->map())
+        return nullptr;
+
+    registry.files[path] = file;
+
+    return file;
+}
+
+void MappedFile::purge()
+{
+    auto& registry{ getRegistry() };
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    for (auto it{ registry.files.begin() }; it != registry.files.end();) {
+        if (it->second.use_count() == 1)
+            it = registry.files.erase(it);
+        else
+            ++it;
+    }
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::map()
+{
+    const int len{ MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0) };
+    std::wstring widePath((size_t)len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), len);
+
+    HANDLE file{ CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr) };
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize{};
+
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* ptr{ MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) };
+
+    if (ptr == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(ptr);
+    size = (size_t)fileSize.QuadPart;
+
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY range{};
+    range.VirtualAddress = const_cast<uint8_t*>(data + offset);
+    range.NumberOfBytes = std::min(length, size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::map()
+{
+    const int fd{ ::open(path.c_str(), O_RDONLY) };
+
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr{ ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (ptr == MAP_FAILED)
+        return false;
+
+    data = static_cast<const uint8_t*>(ptr);
+    size = (size_t)st.st_size;
+
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (data != nullptr)
+        ::munmap(const_cast<uint8_t*>(data), size);
+
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (data == nullptr || offset >= size)
+        return;
+
+    static const size_t pageSize{ (size_t)::sysconf(_SC_PAGESIZE) };
+
+    const size_t begin{ offset & ~(pageSize - 1) };
+    const size_t end{ std::min(size, offset + length) };
+
+    ::madvise(const_cast<uint8_t*>(data + begin), end - begin, MADV_WILLNEED);
+}
+
+#endif
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -0,0 +1,77 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Read-only memory mapping of a file.
+ *
+ * Mappings are shared: opening the same path again returns the
+ * existing mapping, so that all the readers of a file (sample preload,
+ * streams) access the same pages without reopening the file.
+ * The mappings are kept until purged.
+ */
+class MappedFile final
+{
+public:
+
+    using Ptr = std::shared_ptr<MappedFile>;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator =(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /**
+     * Returns a shared mapping of the file, or nullptr
+     * if the file cannot be opened or mapped.
+     */
+    static Ptr open(const std::string& path);
+
+    /**
+     * Unmap all the files that are not referenced anymore.
+     */
+    static void purge();
+
+    const std::string& getPath() const noexcept { return path; }
+    const uint8_t* getData() const noexcept { return data; }
+    size_t getSize() const noexcept { return size; }
+
+    /**
+     * Hint the OS that a range of the file will be accessed soon.
+     */
+    void prefetch(size_t offset, size_t length) const;
+
+private:
+
+    explicit MappedFile(const std::string& filePath);
+    bool map();
+    void unmap();
+
+    std::string path;
+    const uint8_t* data{ nullptr };
+    size_t size{ 0 };
+
+#if defined(_WIN32)
+    void* fileHandle{ nullptr };
+    void* mappingHandle{ nullptr };
+#endif
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
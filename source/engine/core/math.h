@@ -55,7 +55,7 @@ T lagr(T x_1, T x0, T x1, T x2, T frac)
 
 /// Lagrange inperpolation working on an array.
 template <typename T>
-T lagr(T* x, T frac)
+T lagr(const T* x, T frac)
 {
     const T c1{ x[2] - (1.0f / 3.0f) * x[0] - 0.5f * x[1] - (1.0f / 6.0f) * x[3] };
     const T c2{ 0.5f * (x[0] + x[2]) - x[1] };
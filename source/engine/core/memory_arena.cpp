@@ -0,0 +1,79 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "memory_arena.h"
+#include "aligned_memory.h"
+#include <cassert>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+using BlockMemory = AlignedMemory<64>;
+
+MemoryArena::MemoryArena()
+    : numBlocks{ 0 }
+{
+}
+
+MemoryArena::~MemoryArena()
+{
+    for (auto& blocks : freeBlocks) {
+        float* block{ nullptr };
+
+        while (blocks.receive(block))
+            BlockMemory::free(block);
+    }
+}
+
+int MemoryArena::getOrder(size_t size) noexcept
+{
+    int order{ minOrder };
+
+    while (getBlockSize(order) < size) {
+        if (++order > maxOrder)
+            return -1;
+    }
+
+    return order;
+}
+
+float* MemoryArena::acquire(int order)
+{
+    assert(order >= minOrder && order <= maxOrder);
+
+    float* block{ nullptr };
+
+    if (freeBlocks[(size_t)(order - minOrder)].receive(block))
+        return block;
+
+    block = (float*)BlockMemory::alloc(sizeof(float) * getBlockSize(order));
+
+    if (block != nullptr)
+        ++numBlocks;
+
+    return block;
+}
+
+void MemoryArena::release(float* block, int order) noexcept
+{
+    assert(order >= minOrder && order <= maxOrder);
+
+    if (block == nullptr)
+        return;
+
+    // Too many free blocks of that size, give the memory back
+    if (!freeBlocks[(size_t)(order - minOrder)].send(block)) {
+        BlockMemory::free(block);
+        --numBlocks;
+    }
+}
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -0,0 +1,74 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include "mpmc_queue.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Pool of power-of-two sized memory blocks of floats.
+ *
+ * Released blocks are kept in lock-free free lists (one per size),
+ * so that once the arena has warmed up, blocks are acquired and
+ * released from any thread without allocating memory.
+ */
+class MemoryArena final
+{
+public:
+
+    using Ptr = std::shared_ptr<MemoryArena>;
+
+    constexpr static int minOrder{ 6 };     ///< Smallest block of 64 floats.
+    constexpr static int maxOrder{ 24 };    ///< Largest block of 16M floats.
+
+    MemoryArena();
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator =(const MemoryArena&) = delete;
+    ~MemoryArena();
+
+    /**
+     * Returns the order of the smallest block holding a number of floats,
+     * or -1 if it exceeds the largest block.
+     */
+    static int getOrder(size_t size) noexcept;
+    constexpr static size_t getBlockSize(int order) noexcept { return (size_t)1 << order; }
+
+    /**
+     * Acquire a block of 2^order floats, allocating
+     * it only if there is no free block of that size.
+     * The content of the block is undefined.
+     */
+    float* acquire(int order);
+    void release(float* block, int order) noexcept;
+
+    /**
+     * Returns the number of blocks allocated by the arena.
+     */
+    int getNumBlocks() const noexcept { return numBlocks; }
+
+private:
+
+    constexpr static size_t numOrders{ maxOrder - minOrder + 1 };
+    constexpr static size_t maxFreeBlocks{ 64 };    ///< Free blocks kept per size.
+
+    std::array<MPMCQueue<float*, maxFreeBlocks>, numOrders> freeBlocks;
+    std::atomic<int> numBlocks;
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
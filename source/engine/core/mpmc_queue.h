@@ -0,0 +1,129 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Each cell carries a sequence number telling whether it is ready
+ * to be written or read at a given position (D. Vyukov's algorithm).
+ * The size must be a power of two.
+ */
+template <typename T, size_t Size>
+class MPMCQueue final
+{
+public:
+
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "MPMCQueue size must be a power of two");
+
+    MPMCQueue() noexcept
+        : writePos{ 0 },
+          readPos{ 0 }
+    {
+        for (size_t i = 0; i < Size; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator =(const MPMCQueue&) = delete;
+
+    ~MPMCQueue() = default;
+
+    bool send(const T& obj) noexcept
+    {
+        size_t pos{ writePos.load(std::memory_order_relaxed) };
+        Cell* cell{ nullptr };
+
+        for (;;) {
+            cell = &cells[pos & mask];
+            const size_t seq{ cell->sequence.load(std::memory_order_acquire) };
+            const auto diff{ (std::ptrdiff_t)seq - (std::ptrdiff_t)pos };
+
+            if (diff == 0) {
+                if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // Queue is full
+                return false;
+            } else {
+                pos = writePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = obj;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool receive(T& obj) noexcept
+    {
+        size_t pos{ readPos.load(std::memory_order_relaxed) };
+        Cell* cell{ nullptr };
+
+        for (;;) {
+            cell = &cells[pos & mask];
+            const size_t seq{ cell->sequence.load(std::memory_order_acquire) };
+            const auto diff{ (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1) };
+
+            if (diff == 0) {
+                if (readPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // Queue is empty
+                return false;
+            } else {
+                pos = readPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        obj = std::move(cell->data);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Returns approximate number of elements in the queue.
+     */
+    size_t count() const noexcept
+    {
+        const size_t w{ writePos.load(std::memory_order_relaxed) };
+        const size_t r{ readPos.load(std::memory_order_relaxed) };
+        return w > r ? w - r : 0;
+    }
+
+private:
+
+    constexpr static size_t mask{ Size - 1 };
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // Keep producers and consumers on separate cache lines
+    alignas(64) std::atomic<size_t> writePos;
+    alignas(64) std::atomic<size_t> readPos;
+    Cell cells[Size];
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
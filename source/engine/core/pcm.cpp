@@ -0,0 +1,176 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "pcm.h"
+#include "simd.h"
+#include <cassert>
+#include <cstring>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+namespace pcm {
+
+constexpr float s8Norm{ 1.0f / 128.0f };
+constexpr float s16Norm{ 1.0f / 32768.0f };
+constexpr float s24Norm{ 1.0f / 8388608.0f };
+
+static inline int16_t readS16(const uint8_t* p)
+{
+    int16_t x;
+    ::memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static inline int32_t readS24(const uint8_t* p)
+{
+    // Shift into the upper bytes to restore the sign
+    return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+}
+
+static inline float readF32(const uint8_t* p)
+{
+    float x;
+    ::memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+void convertU8(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames)
+{
+    assert(numChannels == 1 || numChannels == 2);
+
+    if (numChannels == 1) {
+        for (size_t i = 0; i < numFrames; ++i)
+            left[i] = (float)((int)src[i] - 128) * s8Norm;
+    } else {
+        for (size_t i = 0; i < numFrames; ++i) {
+            left[i] = (float)((int)src[2 * i] - 128) * s8Norm;
+            right[i] = (float)((int)src[2 * i + 1] - 128) * s8Norm;
+        }
+    }
+}
+
+void convertS16(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames)
+{
+    assert(numChannels == 1 || numChannels == 2);
+
+    size_t i{ 0 };
+
+#if TW_SIMD_SSE
+    const __m128 norm{ _mm_set1_ps(s16Norm) };
+
+    if (numChannels == 1) {
+        for (; i + 8 <= numFrames; i += 8) {
+            const __m128i x{ _mm_loadu_si128((const __m128i*)&src[2 * i]) };
+
+            // Interleave with itself and shift back to sign-extend to 32 bits
+            const __m128i lo{ _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16) };
+            const __m128i hi{ _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16) };
+
+            _mm_storeu_ps(&left[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), norm));
+            _mm_storeu_ps(&left[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), norm));
+        }
+    } else {
+        for (; i + 4 <= numFrames; i += 4) {
+            const __m128i x{ _mm_loadu_si128((const __m128i*)&src[4 * i]) };
+
+            const __m128 lo{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)), norm) };
+            const __m128 hi{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)), norm) };
+
+            _mm_storeu_ps(&left[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(&right[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    }
+#elif TW_SIMD_NEON
+    if (numChannels == 1) {
+        for (; i + 8 <= numFrames; i += 8) {
+            const int16x8_t x{ vld1q_s16((const int16_t*)&src[2 * i]) };
+
+            vst1q_f32(&left[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), s16Norm));
+            vst1q_f32(&left[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), s16Norm));
+        }
+    } else {
+        for (; i + 8 <= numFrames; i += 8) {
+            const int16x8x2_t x{ vld2q_s16((const int16_t*)&src[4 * i]) };
+
+            vst1q_f32(&left[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x.val[0]))), s16Norm));
+            vst1q_f32(&left[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x.val[0]))), s16Norm));
+            vst1q_f32(&right[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x.val[1]))), s16Norm));
+            vst1q_f32(&right[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x.val[1]))), s16Norm));
+        }
+    }
+#endif
+
+    if (numChannels == 1) {
+        for (; i < numFrames; ++i)
+            left[i] = (float)readS16(&src[2 * i]) * s16Norm;
+    } else {
+        for (; i < numFrames; ++i) {
+            left[i] = (float)readS16(&src[4 * i]) * s16Norm;
+            right[i] = (float)readS16(&src[4 * i + 2]) * s16Norm;
+        }
+    }
+}
+
+void convertS24(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames)
+{
+    assert(numChannels == 1 || numChannels == 2);
+
+    if (numChannels == 1) {
+        for (size_t i = 0; i < numFrames; ++i)
+            left[i] = (float)readS24(&src[3 * i]) * s24Norm;
+    } else {
+        for (size_t i = 0; i < numFrames; ++i) {
+            left[i] = (float)readS24(&src[6 * i]) * s24Norm;
+            right[i] = (float)readS24(&src[6 * i + 3]) * s24Norm;
+        }
+    }
+}
+
+void convertF32(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames)
+{
+    assert(numChannels == 1 || numChannels == 2);
+
+    if (numChannels == 1) {
+        // Same layout, this is a plain copy
+        ::memcpy(left, src, sizeof(float) * numFrames);
+        return;
+    }
+
+    size_t i{ 0 };
+
+#if TW_SIMD_SSE
+    for (; i + 4 <= numFrames; i += 4) {
+        const __m128 lo{ _mm_loadu_ps((const float*)&src[8 * i]) };
+        const __m128 hi{ _mm_loadu_ps((const float*)&src[8 * i + 16]) };
+
+        _mm_storeu_ps(&left[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(&right[i], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif TW_SIMD_NEON
+    for (; i + 4 <= numFrames; i += 4) {
+        const float32x4x2_t x{ vld2q_f32((const float*)&src[8 * i]) };
+        vst1q_f32(&left[i], x.val[0]);
+        vst1q_f32(&right[i], x.val[1]);
+    }
+#endif
+
+    for (; i < numFrames; ++i) {
+        left[i] = readF32(&src[8 * i]);
+        right[i] = readF32(&src[8 * i + 4]);
+    }
+}
+
+} // namespace pcm
+
+} // namespace core
+
+TW_NAMESPACE_END
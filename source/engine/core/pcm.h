@@ -0,0 +1,36 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <cstddef>
+#include <cstdint>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Conversion of interleaved PCM data to planar floats.
+ *
+ * The source data may be unaligned (e.g. pointing into a mapped file).
+ * For mono data only the left output is written.
+ */
+namespace pcm {
+
+void convertU8(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames);
+void convertS16(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames);
+void convertS24(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames);
+void convertF32(const uint8_t* src, int numChannels, float* left, float* right, size_t numFrames);
+
+} // namespace pcm
+
+} // namespace core
+
+TW_NAMESPACE_END
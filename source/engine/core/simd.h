@@ -0,0 +1,208 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define TW_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define TW_SIMD_NEON 1
+#endif
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Vector of four floats.
+ *
+ * This is a thin wrapper over SSE or NEON registers with a scalar
+ * fallback, used by the block-processing DSP kernels. Loads and stores
+ * do not require any particular alignment.
+ */
+struct Float4
+{
+#if TW_SIMD_SSE
+    __m128 v;
+#elif TW_SIMD_NEON
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+
+    static Float4 load(const float* ptr) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_loadu_ps(ptr) };
+#elif TW_SIMD_NEON
+        return { vld1q_f32(ptr) };
+#else
+        return { { ptr[0], ptr[1], ptr[2], ptr[3] } };
+#endif
+    }
+
+    static Float4 set(float a, float b, float c, float d) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_setr_ps(a, b, c, d) };
+#elif TW_SIMD_NEON
+        const float tmp[4]{ a, b, c, d };
+        return { vld1q_f32(tmp) };
+#else
+        return { { a, b, c, d } };
+#endif
+    }
+
+    static Float4 fill(float x) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_set1_ps(x) };
+#elif TW_SIMD_NEON
+        return { vdupq_n_f32(x) };
+#else
+        return { { x, x, x, x } };
+#endif
+    }
+
+    void store(float* ptr) const noexcept
+    {
+#if TW_SIMD_SSE
+        _mm_storeu_ps(ptr, v);
+#elif TW_SIMD_NEON
+        vst1q_f32(ptr, v);
+#else
+        ptr[0] = v[0]; ptr[1] = v[1]; ptr[2] = v[2]; ptr[3] = v[3];
+#endif
+    }
+
+    /// Returns a * b + c.
+    static Float4 mulAdd(const Float4& a, const Float4& b, const Float4& c) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) };
+#elif TW_SIMD_NEON
+        return { vmlaq_f32(c.v, a.v, b.v) };
+#else
+        return { { a.v[0] * b.v[0] + c.v[0], a.v[1] * b.v[1] + c.v[1],
+                   a.v[2] * b.v[2] + c.v[2], a.v[3] * b.v[3] + c.v[3] } };
+#endif
+    }
+
+    static Float4 min(const Float4& a, const Float4& b) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_min_ps(a.v, b.v) };
+#elif TW_SIMD_NEON
+        return { vminq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1],
+                   a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3] } };
+#endif
+    }
+
+    static Float4 max(const Float4& a, const Float4& b) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_max_ps(a.v, b.v) };
+#elif TW_SIMD_NEON
+        return { vmaxq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1],
+                   a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3] } };
+#endif
+    }
+
+    static Float4 sqrt(const Float4& a) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_sqrt_ps(a.v) };
+#elif TW_SIMD_NEON && defined(__aarch64__)
+        return { vsqrtq_f32(a.v) };
+#else
+        float tmp[4];
+        a.store(tmp);
+        return set(std::sqrt(tmp[0]), std::sqrt(tmp[1]), std::sqrt(tmp[2]), std::sqrt(tmp[3]));
+#endif
+    }
+
+    /// Transposes a 4x4 matrix given by its rows.
+    static void transpose(Float4& a, Float4& b, Float4& c, Float4& d) noexcept
+    {
+#if TW_SIMD_SSE
+        _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+#elif TW_SIMD_NEON
+        const float32x4x2_t ab{ vtrnq_f32(a.v, b.v) };
+        const float32x4x2_t cd{ vtrnq_f32(c.v, d.v) };
+        a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+#else
+        std::swap(a.v[1], b.v[0]);
+        std::swap(a.v[2], c.v[0]);
+        std::swap(a.v[3], d.v[0]);
+        std::swap(b.v[2], c.v[1]);
+        std::swap(b.v[3], d.v[1]);
+        std::swap(c.v[3], d.v[2]);
+#endif
+    }
+
+    /// Returns the sum of all four elements.
+    float sum() const noexcept
+    {
+        float tmp[4];
+        store(tmp);
+        return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+    }
+
+    friend Float4 operator+(const Float4& a, const Float4& b) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_add_ps(a.v, b.v) };
+#elif TW_SIMD_NEON
+        return { vaddq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+#endif
+    }
+
+    friend Float4 operator-(const Float4& a, const Float4& b) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_sub_ps(a.v, b.v) };
+#elif TW_SIMD_NEON
+        return { vsubq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+#endif
+    }
+
+    friend Float4 operator*(const Float4& a, const Float4& b) noexcept
+    {
+#if TW_SIMD_SSE
+        return { _mm_mul_ps(a.v, b.v) };
+#elif TW_SIMD_NEON
+        return { vmulq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+#endif
+    }
+
+    Float4& operator+=(const Float4& other) noexcept { *this = *this + other; return *this; }
+    Float4& operator*=(const Float4& other) noexcept { *this = *this * other; return *this; }
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -0,0 +1,228 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "thread_pool.h"
+#include <bit>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#endif
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/// Number of busy-wait iterations before an idle thread parks.
+constexpr int spinCount{ 4096 };
+
+static inline void cpuRelax()
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * Spin-wait helper that yields the CPU once spinning
+ * for too long (e.g. when the threads oversubscribe the cores).
+ */
+class Backoff final
+{
+public:
+    void pause()
+    {
+        if (spins < spinCount) {
+            cpuRelax();
+            ++spins;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    void reset() noexcept { spins = 0; }
+
+private:
+    int spins{ 0 };
+};
+
+ThreadPool::ThreadPool(int numThreads)
+{
+    assert(numThreads >= 0);
+
+    for (auto& pending : pendingDependencies)
+        pending = 0;
+
+    for (auto& slot : readyQueue)
+        slot = -1;
+
+    running = true;
+
+    threads.reserve((size_t)numThreads);
+
+    for (int i = 0; i < numThreads; ++i)
+        threads.emplace_back(&ThreadPool::threadLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    running = false;
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_all();
+
+    for (auto& thread : threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void ThreadPool::reset(int n)
+{
+    assert(n >= 0 && n <= maxTasks);
+
+    numTasks = n;
+    predecessors.fill(0);
+    successors.fill(0);
+}
+
+void ThreadPool::addDependency(int task, int dependsOn)
+{
+    assert(task >= 0 && task < numTasks);
+    assert(dependsOn >= 0 && dependsOn < numTasks);
+    assert(task != dependsOn);
+
+    predecessors[task] |= uint64_t(1) << dependsOn;
+    successors[dependsOn] |= uint64_t(1) << task;
+}
+
+void ThreadPool::run(Graph& graph)
+{
+    if (numTasks == 0)
+        return;
+
+    currentGraph.store(&graph, std::memory_order_relaxed);
+
+    for (int i = 0; i < numTasks; ++i) {
+        readyQueue[i].store(-1, std::memory_order_relaxed);
+        pendingDependencies[i].store(std::popcount(predecessors[i]), std::memory_order_relaxed);
+    }
+
+    pushIndex.store(0, std::memory_order_relaxed);
+    popIndex.store(0, std::memory_order_relaxed);
+    remainingTasks.store(numTasks, std::memory_order_release);
+
+    for (int i = 0; i < numTasks; ++i) {
+        if (predecessors[i] == 0)
+            pushTask(i);
+    }
+
+    // Wake up the pool
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_all();
+
+    executeTasks();
+
+    // Make sure no thread is still looking at this run's queue
+    Backoff backoff{};
+
+    while (activeThreads.load(std::memory_order_acquire) > 0)
+        backoff.pause();
+}
+
+void ThreadPool::threadLoop()
+{
+    uint32_t seen{ epoch.load(std::memory_order_acquire) };
+
+    while (running) {
+        int spins{ 0 };
+
+        while (epoch.load(std::memory_order_acquire) == seen && spins < spinCount) {
+            cpuRelax();
+            ++spins;
+        }
+
+        if (epoch.load(std::memory_order_acquire) == seen)
+            epoch.wait(seen, std::memory_order_acquire);
+
+        seen = epoch.load(std::memory_order_acquire);
+
+        if (!running)
+            break;
+
+        activeThreads.fetch_add(1, std::memory_order_acq_rel);
+        executeTasks();
+        activeThreads.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void ThreadPool::executeTasks()
+{
+    Backoff backoff{};
+
+    while (remainingTasks.load(std::memory_order_acquire) > 0) {
+        int task{ -1 };
+
+        if (popTask(task)) {
+            currentGraph.load(std::memory_order_relaxed)->runTask(task);
+            completeTask(task);
+            backoff.reset();
+        } else {
+            backoff.pause();
+        }
+    }
+}
+
+bool ThreadPool::popTask(int& task)
+{
+    int idx{ popIndex.load(std::memory_order_acquire) };
+
+    while (idx < pushIndex.load(std::memory_order_acquire)) {
+        if (popIndex.compare_exchange_weak(idx, idx + 1, std::memory_order_acq_rel)) {
+            // The slot has been claimed, but may not be published yet
+            Backoff backoff{};
+
+            while ((task = readyQueue[idx].load(std::memory_order_acquire)) < 0)
+                backoff.pause();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::pushTask(int task)
+{
+    const int idx{ pushIndex.fetch_add(1, std::memory_order_acq_rel) };
+    assert(idx < maxTasks);
+    readyQueue[idx].store(task, std::memory_order_release);
+}
+
+void ThreadPool::completeTask(int task)
+{
+    uint64_t next{ successors[task] };
+
+    while (next != 0) {
+        const int successor{ std::countr_zero(next) };
+        next &= next - 1;
+
+        if (pendingDependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            pushTask(successor);
+    }
+
+    // Successors must be queued before the task is accounted as complete.
+    remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -0,0 +1,103 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TW_NAMESPACE_BEGIN
+
+namespace core {
+
+/**
+ * Pool of pre-spawned threads executing a graph of tasks.
+ *
+ * Tasks are identified by their index and may depend on other tasks.
+ * A run is started by the calling thread, which also takes part in the
+ * execution and returns once all the tasks are complete. Scheduling is
+ * lock-free: ready tasks are claimed from a shared queue, and idle threads
+ * spin for a short while before parking on an atomic wait (a futex on Linux).
+ *
+ * @note The dependencies must form a directed acyclic graph.
+ */
+class ThreadPool final
+{
+public:
+
+    /**
+     * Interface to the tasks executed by the pool.
+     */
+    class Graph
+    {
+    public:
+        virtual void runTask(int index) = 0;
+        virtual ~Graph() = default;
+    };
+
+    constexpr static int maxTasks{ 64 };
+
+    //------------------------------------------------------
+
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getNumThreads() const noexcept { return (int)threads.size(); }
+
+    /**
+     * Reset the graph to a given number of independent tasks.
+     */
+    void reset(int numTasks);
+
+    /**
+     * Make a task depend on another one.
+     */
+    void addDependency(int task, int dependsOn);
+
+    /**
+     * Execute all the tasks and wait for them to complete.
+     * This should be called on a single (normally the audio) thread.
+     */
+    void run(Graph& graph);
+
+private:
+
+    void threadLoop();
+    void executeTasks();
+    bool popTask(int& task);
+    void pushTask(int task);
+    void completeTask(int task);
+
+    int numTasks{ 0 };
+    std::array<uint64_t, maxTasks> predecessors{};
+    std::array<uint64_t, maxTasks> successors{};
+
+    std::array<std::atomic<int>, maxTasks> pendingDependencies;
+    std::array<std::atomic<int>, maxTasks> readyQueue;
+    std::atomic<int> pushIndex{ 0 };
+    std::atomic<int> popIndex{ 0 };
+    std::atomic<int> remainingTasks{ 0 };
+    std::atomic<int> activeThreads{ 0 };
+
+    std::atomic<Graph*> currentGraph{ nullptr };
+    std::atomic<uint32_t> epoch{ 0 };
+    std::atomic<bool> running{ false };
+
+    std::vector<std::thread> threads;
+};
+
+} // namespace core
+
+TW_NAMESPACE_END
@@ -7,6 +7,7 @@
 // *****************************************************************************
 
 #include "worker.h"
+#include <algorithm>
 #include <cassert>
 
 TW_NAMESPACE_BEGIN
@@ -14,7 +15,10 @@ TW_NAMESPACE_BEGIN
 namespace core {
 
 Worker::Worker()
+    : numPendingJobs{ 0 }
 {
+    // The queue cannot hold more jobs than that, so this never reallocates.
+    pendingJobs.reserve(defaultQueueCapacity);
 }
 
 Worker::~Worker()
@@ -47,15 +51,24 @@ bool Worker::addJob(Job* job)
 {
     assert(job != nullptr);
 
-    const bool ok{ jobsQueue.send(job) };
+    // Already queued
+    if (job->queued.exchange(true, std::memory_order_acq_rel))
+        return true;
+
+    if (!jobsQueue.send(job)) {
+        job->queued.store(false, std::memory_order_release);
+        return false;
+    }
+
+    ++numPendingJobs;
     wakeUp();
 
-    return ok;
+    return true;
 }
 
 bool Worker::hasPendingJobs() const noexcept
 {
-    return jobsQueue.count() > 0;
+    return numPendingJobs > 0;
 }
 
 bool Worker::isRunning() const noexcept
@@ -67,23 +80,63 @@ void Worker::purge()
 {
     Job* job{ nullptr };
 
-    while (jobsQueue.receive(job)) {}
+    while (jobsQueue.receive(job)) {
+        job->queued = false;
+        --numPendingJobs;
+    }
+
+    for (auto* pendingJob : pendingJobs) {
+        pendingJob->queued = false;
+        --numPendingJobs;
+    }
+
+    pendingJobs.clear();
 }
 
 void Worker::run()
 {
     while (running) {
-        Job* job{ nullptr };
-
         wait();
 
-        if (running && jobsQueue.receive(job)) {
-            assert(job != nullptr);
-            job->run();
-        }
+        if (!running)
+            break;
+
+        runNextJob();
     }
 }
 
+bool Worker::runNextJob()
+{
+    Job* job{ nullptr };
+
+    while (jobsQueue.receive(job))
+        pendingJobs.push_back(job);
+
+    if (pendingJobs.empty())
+        return false;
+
+    // Pick the most urgent job. The slack is evaluated here
+    // since it changes while the job is waiting.
+    auto it{ std::min_element(pendingJobs.begin(), pendingJobs.end(),
+                              [](const Job* a, const Job* b) { return a->getSlack() < b->getSlack(); }) };
+
+    job = *it;
+    *it = pendingJobs.back();
+    pendingJobs.pop_back();
+
+    --numPendingJobs;
+
+    // Allow the job to be queued again while it's running.
+    // The running flag is raised first so that the job never
+    // looks idle in between.
+    job->running.store(true, std::memory_order_release);
+    job->queued.store(false, std::memory_order_release);
+    job->run();
+    job->running.store(false, std::memory_order_release);
+
+    return true;
+}
+
 void Worker::wait()
 {
     sema.wait();
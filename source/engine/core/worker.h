@@ -9,10 +9,12 @@
 #pragma once
 
 #include "../globals.h"
-#include "ring_buffer.h"
+#include "mpmc_queue.h"
 #include "sema.h"
+#include <atomic>
 #include <memory>
 #include <thread>
+#include <vector>
 
 TW_NAMESPACE_BEGIN
 
@@ -20,6 +22,11 @@ namespace core {
 
 /**
  * This class runs jobs on a side thread.
+ *
+ * Jobs can be added from any thread. A job that is already queued
+ * is not queued again. Pending jobs are executed in the order of their
+ * slack, so that the most urgent ones (e.g. streams about to underrun)
+ * are served first.
  */
 class Worker final
 {
@@ -30,6 +37,25 @@ public:
     public:
         virtual void run() = 0;
         virtual ~Job() = default;
+
+        /**
+         * Returns how long the job can wait (in arbitrary units).
+         * Jobs with the smallest slack are executed first.
+         */
+        virtual int getSlack() const { return 0; }
+
+        /**
+         * Tells whether the job is queued or being run by a worker.
+         * Once a job is not requeued anymore, this becoming false means
+         * the worker is done with it.
+         */
+        bool isBusy() const noexcept { return queued.load(std::memory_order_acquire) || running.load(std::memory_order_acquire); }
+
+    private:
+        std::atomic<bool> queued{ false };
+        std::atomic<bool> running{ false };
+
+        friend class Worker;
     };
 
     //------------------------------------------------------
@@ -42,6 +68,12 @@ public:
     void start();
     void stop();
 
+    /**
+     * Add a job to the queue.
+     * This can be called from several threads concurrently.
+     *
+     * @returns false if the queue is full.
+     */
     bool addJob(Job* job);
     bool hasPendingJobs() const noexcept;
     bool isRunning() const noexcept;
@@ -50,6 +82,15 @@ public:
 
     void run();
 
+    /**
+     * Run the most urgent pending job on the calling thread.
+     * This is how the worker thread serves the jobs, and can be used
+     * to drive a worker that has not been started.
+     *
+     * @returns false if there was no pending job.
+     */
+    bool runNextJob();
+
 private:
 
     void wait();
@@ -57,7 +98,9 @@ private:
 
     static constexpr size_t defaultQueueCapacity{ 1024 };
 
-    core::RingBuffer<Job*, defaultQueueCapacity> jobsQueue;
+    core::MPMCQueue<Job*, defaultQueueCapacity> jobsQueue;
+    std::vector<Job*> pendingJobs;      ///< Jobs received by the worker thread.
+    std::atomic<int> numPendingJobs;    ///< Jobs added but not started yet.
     Semaphore sema;
     std::atomic_bool running;
     std::unique_ptr<std::thread> thread;
@@ -8,58 +8,258 @@
 
 #include "dsp/delay_line.h"
 #include "core/math.h"
+#include "core/simd.h"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 TW_NAMESPACE_BEGIN
 
 namespace dsp {
 
-DelayLine::DelayLine(int totalLength)
-    : buffer((size_t)totalLength, 0.0f)
+namespace {
+
+using core::Float4;
+
+// Extra samples for the interpolation taps beyond the line length
+constexpr int interpolationMargin{ 4 };
+
+/**
+ * Taps positions of a block read, the read
+ * position moving forward with the frames.
+ */
+struct Taps
+{
+    const float* buffer;
+    size_t mask;
+    size_t writeIndex;
+
+    size_t getIndex(const float* delays, int i, float& frac) const noexcept
+    {
+        const int index{ (int)std::floor(delays[i]) };
+        frac = delays[i] - (float)index;
+        return (writeIndex + (size_t)(index - i)) & mask;
+    }
+
+    float operator [](size_t index) const noexcept { return buffer[index & mask]; }
+};
+
+/**
+ * Tells whether the block read positions stay
+ * within the written history of the line.
+ */
+[[maybe_unused]] bool isWithinCapacity(const float* delays, int numFrames, int capacity) noexcept
+{
+    for (int i = 0; i < numFrames; ++i) {
+        if (delays[i] < (float)i || delays[i] + (float)interpolationMargin > (float)capacity)
+            return false;
+    }
+
+    return true;
+}
+
+void readLinear(const Taps& taps, const float* delays, float* out, int numFrames)
+{
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        float a[4], b[4], frac[4];
+
+        for (int k = 0; k < 4; ++k) {
+            const auto index{ taps.getIndex(delays, i + k, frac[k]) };
+            a[k] = taps[index];
+            b[k] = taps[index + 1];
+        }
+
+        const Float4 va{ Float4::load(a) };
+        (va + (Float4::load(b) - va) * Float4::load(frac)).store(&out[i]);
+    }
+
+    for (; i < numFrames; ++i) {
+        float frac;
+        const auto index{ taps.getIndex(delays, i, frac) };
+        out[i] = core::math::lerp(taps[index], taps[index + 1], frac);
+    }
+}
+
+void readCubic(const Taps& taps, const float* delays, float* out, int numFrames)
+{
+    const Float4 k2{ Float4::fill(0.5f) };
+    const Float4 k3{ Float4::fill(1.0f / 3.0f) };
+    const Float4 k6{ Float4::fill(1.0f / 6.0f) };
+
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        float x[4][4], frac[4];
+
+        for (int k = 0; k < 4; ++k) {
+            const auto index{ taps.getIndex(delays, i + k, frac[k]) };
+            x[0][k] = taps[index - 1];
+            x[1][k] = taps[index];
+            x[2][k] = taps[index + 1];
+            x[3][k] = taps[index + 2];
+        }
+
+        // Same polynomial as core::math::lagr()
+        const Float4 xm1{ Float4::load(x[0]) };
+        const Float4 x0{ Float4::load(x[1]) };
+        const Float4 x1{ Float4::load(x[2]) };
+        const Float4 x2{ Float4::load(x[3]) };
+        const Float4 f{ Float4::load(frac) };
+
+        const Float4 c1{ x1 - k3 * xm1 - k2 * x0 - k6 * x2 };
+        const Float4 c2{ k2 * (xm1 + x1) - x0 };
+        const Float4 c3{ k6 * (x2 - xm1) + k2 * (x0 - x1) };
+
+        (((c3 * f + c2) * f + c1) * f + x0).store(&out[i]);
+    }
+
+    for (; i < numFrames; ++i) {
+        float frac;
+        const auto index{ taps.getIndex(delays, i, frac) };
+        out[i] = core::math::lagr(taps[index - 1], taps[index], taps[index + 1], taps[index + 2], frac);
+    }
+}
+
+void readAllPass(const Taps& taps, const float* delays, float* out, int numFrames, float& state)
+{
+    float y{ state };
+
+    for (int i = 0; i < numFrames; ++i) {
+        float frac;
+        const auto index{ taps.getIndex(delays, i, frac) };
+        const float eta{ (1.0f - frac) / (1.0f + frac) };
+
+        y = eta * taps[index] + taps[index + 1] - eta * y;
+        out[i] = y;
+    }
+
+    state = y;
+}
+
+} // anonymous namespace
+
+DelayLine::DelayLine()
+    : arena{ nullptr }
+    , buffer{ &emptySample }
+    , order{ -1 }
+    , mask{ 0 }
     , writeIndex{ 0 }
+    , length{ 1 }
+    , interpolation{ Interpolation::Linear }
+    , allPassState{ 0.0f }
+    , emptySample{ 0.0f }
 {
-    assert(totalLength > 0);
 }
 
-void DelayLine::resize(int newLength)
+DelayLine::~DelayLine()
 {
+    releaseBuffer();
+}
+
+void DelayLine::prepare(const core::MemoryArena::Ptr& memoryArena, int newLength)
+{
+    assert(memoryArena != nullptr);
     assert(newLength > 0);
-    buffer.resize((size_t)newLength);
+
+    const int newOrder{ core::MemoryArena::getOrder((size_t)(newLength + interpolationMargin)) };
+    assert(newOrder > 0);
+
+    if (memoryArena != arena || newOrder > order) {
+        releaseBuffer();
+
+        arena = memoryArena;
+
+        if (auto* block{ arena->acquire(newOrder) }; block != nullptr) {
+            buffer = block;
+            order = newOrder;
+            mask = core::MemoryArena::getBlockSize(order) - 1;
+        }
+    }
+
+    length = std::min(newLength, getCapacity());
     reset();
 }
 
 void DelayLine::reset()
 {
     writeIndex = 0;
-    ::memset(buffer.data(), 0, sizeof(float) * buffer.size());
+    allPassState = 0.0f;
+    ::memset(buffer, 0, sizeof(float) * (mask + 1));
 }
 
 void DelayLine::write(float x)
 {
-    if (writeIndex == 0)
-        writeIndex = buffer.size() - 1;
-    else
-        --writeIndex;
-
+    writeIndex = (writeIndex - 1) & mask;
     buffer[writeIndex] = x;
 }
 
 float DelayLine::read(float delay) const
 {
-    int index{ (int)std::floor(delay) };
-    float frac{ delay - (float)index };
+    const int index{ (int)std::floor(delay) };
+    const float frac{ delay - (float)index };
+
+    const size_t i{ (writeIndex + (size_t)index) & mask };
+
+    return core::math::lerp(buffer[i], buffer[(i + 1) & mask], frac);
+}
+
+void DelayLine::writeBlock(const float* in, int numFrames)
+{
+    // Samples are written backwards, wrapping once at most
+    while (numFrames > 0) {
+        if (writeIndex == 0)
+            writeIndex = mask + 1;
+
+        const int n{ std::min(numFrames, (int)writeIndex) };
+        float* out{ buffer + writeIndex - 1 };
 
-    index = (index + writeIndex) % (int)buffer.size();
-    const auto a{ buffer[index] };
-    const auto b{ index < buffer.size() - 1 ? buffer[index + 1] : buffer[0] };
+        for (int i = 0; i < n; ++i)
+            out[-i] = in[i];
 
-    return core::math::lerp(a, b, frac);
+        writeIndex -= (size_t)n;
+        in += n;
+        numFrames -= n;
+    }
+
+    writeIndex &= mask;
+}
+
+void DelayLine::readBlock(const float* delays, float* out, int numFrames)
+{
+    assert(order < 0 || isWithinCapacity(delays, numFrames, getCapacity()));
+
+    const Taps taps{ buffer, mask, writeIndex };
+
+    switch (interpolation) {
+    case Interpolation::Linear:
+        readLinear(taps, delays, out, numFrames);
+        break;
+    case Interpolation::Cubic:
+        readCubic(taps, delays, out, numFrames);
+        break;
+    case Interpolation::AllPass:
+        readAllPass(taps, delays, out, numFrames, allPassState);
+        break;
+    }
 }
 
 int DelayLine::getLength() const noexcept
 {
-    return (int)buffer.size();
+    return length;
+}
+
+void DelayLine::releaseBuffer() noexcept
+{
+    if (arena != nullptr && order >= 0)
+        arena->release(buffer, order);
+
+    buffer = &emptySample;
+    order = -1;
+    mask = 0;
+    writeIndex = 0;
 }
 
 } // namespace dsp
@@ -9,29 +9,91 @@
 #pragma once
 
 #include "../globals.h"
-#include <vector>
+#include "core/memory_arena.h"
 
 TW_NAMESPACE_BEGIN
 
 namespace dsp {
 
 /**
- * Delay line with linear interpolation.
+ * Delay line with fractional delays.
+ *
+ * The line capacity is a power of two so that the positions wrap
+ * with a mask. Its memory is taken from a shared arena when the
+ * line is prepared, and is kept as long as it is large enough.
+ *
+ * The delays are counted from the last written sample,
+ * a zero delay reading back the last written sample.
  */
 class DelayLine final
 {
 public:
-    DelayLine(int totalLength = 1024);
-    void resize(int newLength);
+
+    enum class Interpolation
+    {
+        Linear,
+        Cubic,      ///< Lagrange 3rd order, reads one sample ahead (delays of at least one sample).
+        AllPass     ///< 1st order all-pass, keeps a state (a single reader per line).
+    };
+
+    DelayLine();
+    DelayLine(const DelayLine&) = delete;
+    DelayLine& operator =(const DelayLine&) = delete;
+    ~DelayLine();
+
+    /**
+     * Prepare the line for delays up to a given length (in samples) and clear it.
+     * This allocates only when the arena has no free block large enough.
+     */
+    void prepare(const core::MemoryArena::Ptr& memoryArena, int length);
     void reset();
+
+    void setInterpolation(Interpolation type) noexcept { interpolation = type; }
+    Interpolation getInterpolation() const noexcept { return interpolation; }
+
     void write(float x);
+
+    /**
+     * Read a single sample, with linear interpolation.
+     */
     float read(float delay) const;
 
+    /**
+     * Write a block of samples, oldest first.
+     */
+    void writeBlock(const float* in, int numFrames);
+
+    /**
+     * Read a block of samples with the selected interpolation.
+     *
+     * The read position moves forward by one sample per frame, as if the
+     * frames of the block were being written meanwhile: out[i] = read(delays[i] - i).
+     * The delays must therefore not be shorter than i, and the line must
+     * have been prepared for the longest delay.
+     */
+    void readBlock(const float* delays, float* out, int numFrames);
+
+    /**
+     * Returns the length the line has been prepared for.
+     */
     int getLength() const noexcept;
+    int getCapacity() const noexcept { return (int)mask + 1; }
 
 private:
-    std::vector<float> buffer;
+
+    void releaseBuffer() noexcept;
+
+    core::MemoryArena::Ptr arena;
+    float* buffer;
+    int order;
+    size_t mask;
     size_t writeIndex;
+    int length;
+
+    Interpolation interpolation;
+    float allPassState;
+
+    float emptySample;      ///< Buffer of an unprepared line.
 };
 
 } // namespace dsp
@@ -7,12 +7,68 @@
 // *****************************************************************************
 
 #include "envelope.h"
+#include "core/simd.h"
+#include <algorithm>
 #include <cmath>
 
 TW_NAMESPACE_BEGIN
 
 namespace dsp {
 
+namespace {
+
+/**
+ * Run a segment's level = base + level * coef recurrence over a block,
+ * until the level reaches the segment's limit.
+ *
+ * Four frames are computed at once from the powers of the coefficient.
+ * The segments are monotonic, so the block's last frame tells whether
+ * the limit is reached, in which case the frames are run one by one.
+ *
+ * @returns the number of frames written before the limit is reached.
+ */
+template <typename Reached>
+int runSegment(float base, float coef, float& level, float* out, int numFrames, Reached reached)
+{
+    using core::Float4;
+
+    const float c2{ coef * coef };
+    const Float4 c{ Float4::set(coef, c2, c2 * coef, c2 * c2) };
+
+    const float b2{ base + base * coef };
+    const float b3{ base + b2 * coef };
+    const Float4 b{ Float4::set(base, b2, b3, base + b3 * coef) };
+
+    float y{ level };
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        float v[4];
+        Float4::mulAdd(Float4::fill(y), c, b).store(v);
+
+        if (reached(v[3]))
+            break;
+
+        std::copy(v, v + 4, &out[i]);
+        y = v[3];
+    }
+
+    for (; i < numFrames; ++i) {
+        const float next{ base + y * coef };
+
+        if (reached(next))
+            break;
+
+        out[i] = y = next;
+    }
+
+    level = y;
+
+    return i;
+}
+
+} // anonymous namespace
+
 Envelope::Envelope()
 {
 }
@@ -93,6 +149,51 @@ float Envelope::getNext()
     return currentLevel;
 }
 
+void Envelope::process(float* out, int numFrames)
+{
+    int i{ 0 };
+
+    while (i < numFrames) {
+        switch (currentState) {
+        case State::Attack:
+            i += runSegment(attackBase, attackCoef, currentLevel, &out[i], numFrames - i,
+                            [](float x) { return x >= 1.0f; });
+
+            if (i < numFrames) {
+                currentLevel = 1.0f;
+                currentState = State::Decay;
+                out[i++] = currentLevel;
+            }
+            break;
+        case State::Decay:
+            i += runSegment(decayBase, decayCoef, currentLevel, &out[i], numFrames - i,
+                            [this](float x) { return x <= sustainLevel; });
+
+            if (i < numFrames) {
+                currentLevel = sustainLevel;
+                currentState = State::Sustain;
+                out[i++] = currentLevel;
+            }
+            break;
+        case State::Release:
+            i += runSegment(releaseBase, releaseCoef, currentLevel, &out[i], numFrames - i,
+                            [](float x) { return x <= 0.0f; });
+
+            if (i < numFrames) {
+                currentLevel = 0.0f;
+                currentState = State::Off;
+                out[i++] = currentLevel;
+            }
+            break;
+        default:
+            // Off and sustain levels are constant
+            std::fill(&out[i], &out[numFrames], currentLevel);
+            i = numFrames;
+            break;
+        }
+    }
+}
+
 float Envelope::calculate(float rate, float targetRatio)
 {
     return rate <= 0 ? 0.0f : std::exp(-std::log((1.0f + targetRatio) / targetRatio) / rate);
@@ -53,6 +53,13 @@ public:
 
     float getNext();
 
+    /**
+     * Generate a block of the envelope, the same as calling getNext()
+     * for each frame. Segments are run four frames at a time and
+     * constant stages (sustain, off) are filled.
+     */
+    void process(float* out, int numFrames);
+
     float getLevel() const noexcept { return currentLevel; }
 
 private:
@@ -8,6 +8,7 @@
 
 #include "filters.h"
 #include "core/math.h"
+#include "core/simd.h"
 #include <cstring>
 #include <cassert>
 
@@ -166,6 +167,97 @@ void BiquadFilter::process(const Spec& spec, State& state, const float* in, floa
     }
 }
 
+namespace {
+
+/**
+ * Stereo direct form I biquad, left and right in the first two lanes.
+ * With Ramp the coefficients move from spec to target over the frames.
+ */
+template <bool Ramp>
+void processBiquadStereo(const BiquadFilter::Spec& spec, const BiquadFilter::Spec& target,
+                         BiquadFilter::State& stateL, BiquadFilter::State& stateR,
+                         const float* inL, const float* inR, float* outL, float* outR, int numFrames)
+{
+    using core::Float4;
+
+    // Feedback coefficients are negated so that everything is a sum
+    Float4 b0{ Float4::fill(spec.b[0]) };
+    Float4 b1{ Float4::fill(spec.b[1]) };
+    Float4 b2{ Float4::fill(spec.b[2]) };
+    Float4 a1{ Float4::fill(-spec.a[1]) };
+    Float4 a2{ Float4::fill(-spec.a[2]) };
+
+    Float4 db0{ Float4::fill(0.0f) };
+    Float4 db1{ Float4::fill(0.0f) };
+    Float4 db2{ Float4::fill(0.0f) };
+    Float4 da1{ Float4::fill(0.0f) };
+    Float4 da2{ Float4::fill(0.0f) };
+
+    if constexpr (Ramp) {
+        const float k{ numFrames > 0 ? 1.0f / (float)numFrames : 0.0f };
+        db0 = Float4::fill(k * (target.b[0] - spec.b[0]));
+        db1 = Float4::fill(k * (target.b[1] - spec.b[1]));
+        db2 = Float4::fill(k * (target.b[2] - spec.b[2]));
+        da1 = Float4::fill(k * (spec.a[1] - target.a[1]));
+        da2 = Float4::fill(k * (spec.a[2] - target.a[2]));
+    }
+
+    Float4 x1{ Float4::set(stateL.x[0], stateR.x[0], 0.0f, 0.0f) };
+    Float4 x2{ Float4::set(stateL.x[1], stateR.x[1], 0.0f, 0.0f) };
+    Float4 y1{ Float4::set(stateL.y[0], stateR.y[0], 0.0f, 0.0f) };
+    Float4 y2{ Float4::set(stateL.y[1], stateR.y[1], 0.0f, 0.0f) };
+
+    float tmp[4];
+
+    for (int i = 0; i < numFrames; ++i) {
+        if constexpr (Ramp) {
+            b0 += db0;
+            b1 += db1;
+            b2 += db2;
+            a1 += da1;
+            a2 += da2;
+        }
+
+        const Float4 x{ Float4::set(inL[i], inR[i], 0.0f, 0.0f) };
+        const Float4 y{ Float4::mulAdd(b0, x, Float4::mulAdd(b1, x1, Float4::mulAdd(b2, x2,
+                        Float4::mulAdd(a1, y1, a2 * y2)))) };
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+
+        y.store(tmp);
+        outL[i] = tmp[0];
+        outR[i] = tmp[1];
+    }
+
+    const auto storeState = [&](const Float4& v, float& l, float& r) {
+        v.store(tmp);
+        l = tmp[0];
+        r = tmp[1];
+    };
+
+    storeState(x1, stateL.x[0], stateR.x[0]);
+    storeState(x2, stateL.x[1], stateR.x[1]);
+    storeState(y1, stateL.y[0], stateR.y[0]);
+    storeState(y2, stateL.y[1], stateR.y[1]);
+}
+
+} // anonymous namespace
+
+void BiquadFilter::processStereo(const Spec& spec, State& stateL, State& stateR,
+                                 const float* inL, const float* inR, float* outL, float* outR, int numFrames)
+{
+    processBiquadStereo<false>(spec, spec, stateL, stateR, inL, inR, outL, outR, numFrames);
+}
+
+void BiquadFilter::processStereo(const Spec& spec, const Spec& target, State& stateL, State& stateR,
+                                 const float* inL, const float* inR, float* outL, float* outR, int numFrames)
+{
+    processBiquadStereo<true>(spec, target, stateL, stateR, inL, inR, outL, outR, numFrames);
+}
+
 //==============================================================================
 
 void LR4Filter::update(LR4Filter::Spec& spec)
@@ -55,6 +55,21 @@ struct BiquadFilter
     static void reset(const Spec& spec, State& state);
     static float tick(const Spec& spec, State& state, float in);
     static void process(const Spec& spec, State& state, const float* in, float* out, int numFrames);
+
+    /**
+     * Process a pair of channels at once, both channels
+     * being computed in the lanes of the same vector.
+     */
+    static void processStereo(const Spec& spec, State& stateL, State& stateR,
+                              const float* inL, const float* inR, float* outL, float* outR, int numFrames);
+
+    /**
+     * Process a pair of channels while linearly interpolating the
+     * coefficients from spec to target over the frames. This is used to
+     * modulate the filter without updating it on every sample.
+     */
+    static void processStereo(const Spec& spec, const Spec& target, State& stateL, State& stateR,
+                              const float* inL, const float* inR, float* outL, float* outR, int numFrames);
 };
 
 //==============================================================================
@@ -8,6 +8,7 @@
 
 #include "hilbert.h"
 #include "core/math.h"
+#include <algorithm>
 #include <cassert>
 #include <array>
 #include <unordered_map>
@@ -241,6 +242,112 @@ void Hilbert::process(const Spec& spec, State& state, const float* in, float* ou
         tick(spec, state, in[i], outR[i], outI[i]);
 }
 
+void Hilbert::reset(const Spec&, VectorState& state)
+{
+    const auto zero{ core::Float4::fill(0.0f) };
+
+    for (auto* states : { state.frStates, state.fiStates }) {
+        for (size_t i = 0; i < AllPass::length; ++i)
+            states[i] = { { zero, zero }, { zero, zero } };
+    }
+
+    state.frDelayed = zero;
+}
+
+namespace {
+
+// Frames are processed one all-pass filter at a time
+constexpr int vectorBlockSize{ 64 };
+
+void processAllPasses(const Hilbert::AllPass::Spec& spec, Hilbert::VectorState::AllPassState* states,
+                      core::Float4* data, int numFrames)
+{
+    using core::Float4;
+
+    for (size_t s = 0; s < Hilbert::AllPass::length; ++s) {
+        const Float4 alpha{ Float4::fill(spec.specs[s].alpha) };
+        auto st{ states[s] };
+
+        for (int i = 0; i < numFrames; ++i) {
+            const Float4 x{ data[i] };
+            const Float4 y{ (x + st.y[1]) * alpha - st.x[1] };
+            st.y[1] = st.y[0];
+            st.y[0] = y;
+            st.x[1] = st.x[0];
+            st.x[0] = x;
+            data[i] = y;
+        }
+
+        states[s] = st;
+    }
+}
+
+} // anonymous namespace
+
+void Hilbert::process(const Spec& spec, VectorState& state, const core::Float4* in,
+                      core::Float4* outR, core::Float4* outI, int numFrames)
+{
+    using core::Float4;
+
+    Float4 re[vectorBlockSize];
+
+    while (numFrames > 0) {
+        const int n{ std::min(numFrames, vectorBlockSize) };
+
+        for (int i = 0; i < n; ++i) {
+            re[i] = in[i];
+            outI[i] = in[i];
+        }
+
+        processAllPasses(spec.frSpec, state.frStates, re, n);
+        processAllPasses(spec.fiSpec, state.fiStates, outI, n);
+
+        // The real part is delayed by one frame
+        outR[0] = state.frDelayed;
+
+        for (int i = 1; i < n; ++i)
+            outR[i] = re[i - 1];
+
+        state.frDelayed = re[n - 1];
+
+        in += n;
+        outR += n;
+        outI += n;
+        numFrames -= n;
+    }
+}
+
+void Hilbert::processMagnitude(const Spec& spec, VectorState& state, const core::Float4* in, core::Float4* out, int numFrames)
+{
+    using core::Float4;
+
+    Float4 re[vectorBlockSize];
+
+    while (numFrames > 0) {
+        const int n{ std::min(numFrames, vectorBlockSize) };
+
+        for (int i = 0; i < n; ++i) {
+            re[i] = in[i];
+            out[i] = in[i];
+        }
+
+        processAllPasses(spec.frSpec, state.frStates, re, n);
+        processAllPasses(spec.fiSpec, state.fiStates, out, n);
+
+        // The real part is delayed by one frame
+        for (int i = 0; i < n; ++i) {
+            const Float4 r{ i == 0 ? state.frDelayed : re[i - 1] };
+            out[i] = Float4::sqrt(r * r + out[i] * out[i]);
+        }
+
+        state.frDelayed = re[n - 1];
+
+        in += n;
+        out += n;
+        numFrames -= n;
+    }
+}
+
 } // namespace dsp
 
 TW_NAMESPACE_END
@@ -10,6 +10,7 @@
 
 #include "../globals.h"
 #include "dsp/filters.h"
+#include "core/simd.h"
 #include <complex>
 
 TW_NAMESPACE_BEGIN
@@ -44,11 +45,43 @@ struct Hilbert
         float frDelayed;
     };
 
+    /**
+     * State of four transforms running in the lanes of SIMD vectors.
+     */
+    struct VectorState
+    {
+        struct AllPassState
+        {
+            core::Float4 x[2];
+            core::Float4 y[2];
+        };
+
+        AllPassState frStates[AllPass::length];
+        AllPassState fiStates[AllPass::length];
+        core::Float4 frDelayed;
+    };
+
     static void update(Spec& spec);
     static void reset(const Spec& spec, State& state);
     static void tick(const Spec& spec, State& state, float in, float& ourR, float& outI);
     static std::complex<float> tick (const Spec& spec, State& state, float in);
     static void process(const Spec& spec, State& state, const float* in, float* outR, float* outI, int numFrames);
+
+    static void reset(const Spec& spec, VectorState& state);
+
+    /**
+     * Process four signals in the lanes of the vectors, one vector per frame.
+     * The input may be the same buffer as one of the outputs.
+     */
+    static void process(const Spec& spec, VectorState& state, const core::Float4* in,
+                        core::Float4* outR, core::Float4* outI, int numFrames);
+
+    /**
+     * Compute the magnitude of the quadrature pair of four signals,
+     * one vector per frame. This is the same as std::abs(tick(...))
+     * on each lane.
+     */
+    static void processMagnitude(const Spec& spec, VectorState& state, const core::Float4* in, core::Float4* out, int numFrames);
 };
 
 } // namespace dsp
@@ -0,0 +1,59 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "oscillator.h"
+#include <cmath>
+
+TW_NAMESPACE_BEGIN
+
+namespace dsp {
+
+void QuadratureOscillator::update(Spec& spec)
+{
+    spec.c = std::cos(spec.increment);
+    spec.s = std::sin(spec.increment);
+}
+
+void QuadratureOscillator::reset(const Spec&, State& state, float phase)
+{
+    state.c = std::cos(phase);
+    state.s = std::sin(phase);
+}
+
+void QuadratureOscillator::process(const Spec& spec, State& state, float* outC, float* outS, int numFrames)
+{
+    float c{ state.c };
+    float s{ state.s };
+
+    for (int i = 0; i < numFrames; ++i) {
+        outC[i] = c;
+        outS[i] = s;
+
+        const float nc{ c * spec.c - s * spec.s };
+        s = s * spec.c + c * spec.s;
+        c = nc;
+    }
+
+    state.c = c;
+    state.s = s;
+
+    normalize(state);
+}
+
+void QuadratureOscillator::normalize(State& state)
+{
+    // The magnitude stays close to one, so that a single
+    // Newton step is enough to approximate 1/sqrt()
+    const float g{ 1.5f - 0.5f * (state.c * state.c + state.s * state.s) };
+    state.c *= g;
+    state.s *= g;
+}
+
+} // namespace dsp
+
+TW_NAMESPACE_END
@@ -0,0 +1,72 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+
+TW_NAMESPACE_BEGIN
+
+namespace dsp {
+
+/**
+ * Quadrature (cosine and sine) oscillator.
+ *
+ * The oscillator rotates a unit vector by a fixed angle on every
+ * sample, so that no trigonometric function is evaluated once the
+ * increment has been set. The vector's magnitude is renormalized
+ * after each processed block to prevent it from drifting.
+ */
+struct QuadratureOscillator
+{
+    struct Spec
+    {
+        float increment{ 0.0f };    ///< Phase increment in radians per sample.
+
+        float c{ 1.0f };
+        float s{ 0.0f };
+    };
+
+    struct State
+    {
+        float c;
+        float s;
+    };
+
+    static void update(Spec& spec);
+
+    /**
+     * Reset the oscillator to a given phase (in radians).
+     */
+    static void reset(const Spec& spec, State& state, float phase = 0.0f);
+
+    /**
+     * Output the current cosine and sine, then advance the phase.
+     */
+    static void tick(const Spec& spec, State& state, float& outC, float& outS)
+    {
+        outC = state.c;
+        outS = state.s;
+
+        const float c{ state.c * spec.c - state.s * spec.s };
+        const float s{ state.s * spec.c + state.c * spec.s };
+        state.c = c;
+        state.s = s;
+    }
+
+    static void process(const Spec& spec, State& state, float* outC, float* outS, int numFrames);
+
+    /**
+     * Bring the oscillator's vector back to the unit circle.
+     */
+    static void normalize(State& state);
+};
+
+} // namespace dsp
+
+TW_NAMESPACE_END
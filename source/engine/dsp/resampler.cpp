@@ -0,0 +1,107 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "dsp/resampler.h"
+#include "core/math.h"
+#include "core/simd.h"
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+TW_NAMESPACE_BEGIN
+
+namespace dsp {
+
+/// Lagrange polynomial evaluated on four lanes at once (see core::math::lagr).
+static inline core::Float4 lagr4(const core::Float4& x0, const core::Float4& x1,
+                                 const core::Float4& x2, const core::Float4& x3,
+                                 const core::Float4& frac)
+{
+    using core::Float4;
+
+    const Float4 half{ Float4::fill(0.5f) };
+    const Float4 third{ Float4::fill(1.0f / 3.0f) };
+    const Float4 sixth{ Float4::fill(1.0f / 6.0f) };
+
+    const Float4 c1{ x2 - third * x0 - half * x1 - sixth * x3 };
+    const Float4 c2{ half * (x0 + x2) - x1 };
+    const Float4 c3{ sixth * (x3 - x0) + half * (x1 - x2) };
+
+    return Float4::mulAdd(Float4::mulAdd(Float4::mulAdd(c3, frac, c2), frac, c1), frac, x1);
+}
+
+int Resampler::computePositions(float& acc, const float* rates, int* index, float* frac, int numFrames)
+{
+    assert(numFrames <= maxBlockSize);
+
+    float a{ acc };
+    int k{ 0 };
+
+    for (int i = 0; i < numFrames; ++i) {
+        a += std::min(rates[i], maxRate);
+
+        const int n{ (int)a };
+        k += n;
+        a -= (float)n;
+
+        index[i] = k;
+        frac[i] = a;
+    }
+
+    acc = a;
+
+    return k;
+}
+
+void Resampler::interpolate(const float* src, const int* index, const float* frac, float* out, int numFrames)
+{
+    using core::Float4;
+
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        const float* p0{ &src[index[i]] };
+        const float* p1{ &src[index[i + 1]] };
+        const float* p2{ &src[index[i + 2]] };
+        const float* p3{ &src[index[i + 3]] };
+
+        const Float4 x0{ Float4::set(p0[0], p1[0], p2[0], p3[0]) };
+        const Float4 x1{ Float4::set(p0[1], p1[1], p2[1], p3[1]) };
+        const Float4 x2{ Float4::set(p0[2], p1[2], p2[2], p3[2]) };
+        const Float4 x3{ Float4::set(p0[3], p1[3], p2[3], p3[3]) };
+
+        lagr4(x0, x1, x2, x3, Float4::load(&frac[i])).store(&out[i]);
+    }
+
+    for (; i < numFrames; ++i)
+        out[i] = core::math::lagr(&src[index[i]], frac[i]);
+}
+
+void Resampler::interpolate(const float* src, float frac, float* out, int numFrames)
+{
+    using core::Float4;
+
+    if (frac == 0.0f) {
+        ::memcpy(out, &src[1], sizeof(float) * numFrames);
+        return;
+    }
+
+    const Float4 f{ Float4::fill(frac) };
+
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4)
+        lagr4(Float4::load(&src[i]), Float4::load(&src[i + 1]), Float4::load(&src[i + 2]), Float4::load(&src[i + 3]), f).store(&out[i]);
+
+    for (; i < numFrames; ++i)
+        out[i] = core::math::lagr(&src[i], frac);
+}
+
+} // namespace dsp
+
+TW_NAMESPACE_END
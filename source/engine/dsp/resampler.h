@@ -0,0 +1,61 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "../globals.h"
+
+TW_NAMESPACE_BEGIN
+
+namespace dsp {
+
+/**
+ * Block resampler kernels using 4-point Lagrange interpolation.
+ *
+ * The source signal is expected to be laid out as a contiguous span
+ * of historySize past frames followed by the newly read frames. An output
+ * frame with the source index k and fraction f interpolates between
+ * src[k + 1] and src[k + 2] using src[k ... k + 3] as the control points.
+ */
+struct Resampler
+{
+    constexpr static int historySize{ 4 };      ///< Number of past source frames to keep.
+    constexpr static int maxBlockSize{ 32 };    ///< Max number of output frames per block.
+    constexpr static float maxRate{ 16.0f };    ///< Max source frames consumed per output frame.
+
+    /// Source buffer capacity needed to resample one block.
+    constexpr static int sourceBufferSize{ historySize + maxBlockSize * (int)maxRate };
+
+    /**
+     * Compute source positions for a block of output frames.
+     *
+     * @param acc       Fractional read position accumulator, updated on return.
+     * @param rates     Per output frame playback rate (source frames per output frame).
+     * @param index     Output source indices.
+     * @param frac      Output interpolation fractions.
+     * @param numFrames Number of output frames.
+     *
+     * @returns the number of source frames the block consumes.
+     */
+    static int computePositions(float& acc, const float* rates, int* index, float* frac, int numFrames);
+
+    /**
+     * Interpolate a block of frames at given positions.
+     */
+    static void interpolate(const float* src, const int* index, const float* frac, float* out, int numFrames);
+
+    /**
+     * Interpolate a block of frames at a unity rate.
+     * This is a 4-tap FIR with fixed coefficients: out[i] = lagr(&src[i], frac).
+     */
+    static void interpolate(const float* src, float frac, float* out, int numFrames);
+};
+
+} // namespace dsp
+
+TW_NAMESPACE_END
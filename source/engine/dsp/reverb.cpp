@@ -0,0 +1,285 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "reverb.h"
+#include "core/simd.h"
+#include <algorithm>
+
+TW_NAMESPACE_BEGIN
+
+namespace dsp {
+
+namespace {
+
+using core::Float4;
+
+constexpr size_t numCombLines{ 2 * StereoReverb::numCombs };
+constexpr size_t numCombVectors{ numCombLines / 4 };
+constexpr size_t combMask{ StereoReverb::combBufferSize - 1 };
+constexpr size_t allPassMask{ StereoReverb::allPassBufferSize - 1 };
+
+static_assert((StereoReverb::combBufferSize & combMask) == 0);
+static_assert((StereoReverb::allPassBufferSize & allPassMask) == 0);
+
+/// Delay of each comb line, left channel first.
+constexpr std::array<size_t, numCombLines> makeCombDelays()
+{
+    std::array<size_t, numCombLines> delays{};
+
+    for (size_t i = 0; i < StereoReverb::numCombs; ++i) {
+        delays[i] = StereoReverb::combTuning[i];
+        delays[i + StereoReverb::numCombs] = StereoReverb::combTuning[i] + StereoReverb::stereoSpread;
+    }
+
+    return delays;
+}
+
+constexpr auto combDelays{ makeCombDelays() };
+
+constexpr float allPassFeedback{ 0.5f };
+
+/// Frames are processed in sub-blocks of this size.
+constexpr int maxBlockSize{ 64 };
+
+static_assert(StereoReverb::allPassTuning[StereoReverb::numAllPasses - 1] > maxBlockSize,
+              "All-pass lines must be read before being written within a sub-block");
+
+/**
+ * Comb filters of both channels, four lines per vector.
+ */
+struct CombBank
+{
+    float* lines;
+    Float4 feedback;
+    Float4 damp;
+    Float4 undamp;
+    Float4 y[numCombVectors];
+
+    CombBank(const StereoReverb::Spec& spec, StereoReverb::State& state) noexcept
+        : lines{ state.combs.data() }
+        , feedback{ Float4::fill(spec.roomSize) }
+        , damp{ Float4::fill(spec.damp) }
+        , undamp{ Float4::fill(1.0f - spec.damp) }
+    {
+        for (size_t v = 0; v < numCombVectors; ++v)
+            y[v] = Float4::load(&state.combY[v * 4]);
+    }
+
+    /// Save the damping filters to the reverb state.
+    void store(StereoReverb::State& state) const noexcept
+    {
+        for (size_t v = 0; v < numCombVectors; ++v)
+            y[v].store(&state.combY[v * 4]);
+    }
+
+    float* line(size_t index) const noexcept { return lines + index * StereoReverb::combLineStride; }
+
+    /// Process a single frame, gathering the lines one by one.
+    void processFrame(size_t writeIndex, float inL, float inR, float& outL, float& outR) noexcept
+    {
+        const Float4 xs[2]{ Float4::fill(inL), Float4::fill(inR) };
+        Float4 o[numCombVectors];
+
+        for (size_t v = 0; v < numCombVectors; ++v) {
+            const size_t l{ v * 4 };
+            const auto read = [&](size_t k) {
+                return line(l + k)[(writeIndex - combDelays[l + k]) & combMask];
+            };
+
+            o[v] = Float4::set(read(0), read(1), read(2), read(3));
+            y[v] = Float4::mulAdd(o[v], undamp, y[v] * damp);
+
+            float w[4];
+            Float4::mulAdd(y[v], feedback, xs[v / (numCombVectors / 2)]).store(w);
+
+            for (size_t k = 0; k < 4; ++k)
+                line(l + k)[writeIndex] = w[k];
+        }
+
+        outL = (o[0] + o[1]).sum();
+        outR = (o[2] + o[3]).sum();
+    }
+
+    /// Returns the number of frames until a line position wraps around.
+    size_t getFramesUntilWrap(size_t writeIndex) const noexcept
+    {
+        size_t n{ StereoReverb::combBufferSize - writeIndex };
+
+        for (size_t l = 0; l < numCombLines; ++l)
+            n = std::min(n, StereoReverb::combBufferSize - ((writeIndex - combDelays[l]) & combMask));
+
+        return n;
+    }
+
+    /// Process four frames, with vector loads and stores on each line.
+    /// None of the lines must wrap around within those frames.
+    void processFrames(size_t writeIndex, const float* inL, const float* inR, float* outL, float* outR) noexcept
+    {
+        size_t readIndex[numCombLines];
+
+        for (size_t l = 0; l < numCombLines; ++l)
+            readIndex[l] = (writeIndex - combDelays[l]) & combMask;
+
+        // Sum of the lines of each channel, per frame
+        Float4 sums[2][4];
+
+        for (size_t v = 0; v < numCombVectors; ++v) {
+            const size_t l{ v * 4 };
+            const size_t ch{ v / (numCombVectors / 2) };
+            const float* in{ ch == 0 ? inL : inR };
+
+            // Frames of each line, transposed to the lines of each frame
+            Float4 o[4];
+
+            for (size_t k = 0; k < 4; ++k)
+                o[k] = Float4::load(&line(l + k)[readIndex[l + k]]);
+
+            Float4::transpose(o[0], o[1], o[2], o[3]);
+
+            Float4 w[4];
+            Float4 yv{ y[v] };
+
+            for (size_t t = 0; t < 4; ++t) {
+                yv = Float4::mulAdd(o[t], undamp, yv * damp);
+                w[t] = Float4::mulAdd(yv, feedback, Float4::fill(in[t]));
+                sums[ch][t] = v % (numCombVectors / 2) == 0 ? o[t] : sums[ch][t] + o[t];
+            }
+
+            y[v] = yv;
+
+            Float4::transpose(w[0], w[1], w[2], w[3]);
+
+            for (size_t k = 0; k < 4; ++k)
+                w[k].store(&line(l + k)[writeIndex]);
+        }
+
+        // Frames in lanes
+        for (size_t ch = 0; ch < 2; ++ch) {
+            auto& s{ sums[ch] };
+            Float4::transpose(s[0], s[1], s[2], s[3]);
+            ((s[0] + s[1]) + (s[2] + s[3])).store(ch == 0 ? outL : outR);
+        }
+    }
+};
+
+/**
+ * Series all-pass filters of one channel, in place over a sub-block.
+ * The delays being longer than the sub-block, the frames of a sub-block
+ * do not depend on each other within a filter.
+ */
+void processAllPasses(float* lines, size_t index, size_t spread, float* x, int numFrames) noexcept
+{
+    const Float4 feedback{ Float4::fill(allPassFeedback) };
+
+    for (size_t i = 0; i < StereoReverb::numAllPasses; ++i) {
+        float* line{ lines + i * StereoReverb::allPassBufferSize };
+        size_t readIndex{ (index - StereoReverb::allPassTuning[i] - spread) & allPassMask };
+        size_t writeIndex{ index };
+        int j{ 0 };
+
+        while (j < numFrames) {
+            // Contiguous frames until one of the positions wraps around
+            const int n{ (int)std::min({ (size_t)(numFrames - j),
+                                         StereoReverb::allPassBufferSize - readIndex,
+                                         StereoReverb::allPassBufferSize - writeIndex }) };
+
+            const float* src{ &line[readIndex] };
+            float* dst{ &line[writeIndex] };
+            float* y{ &x[j] };
+            int k{ 0 };
+
+            for (; k + 4 <= n; k += 4) {
+                const Float4 bufOut{ Float4::load(&src[k]) };
+                const Float4 in{ Float4::load(&y[k]) };
+                Float4::mulAdd(bufOut, feedback, in).store(&dst[k]);
+                (bufOut - in).store(&y[k]);
+            }
+
+            for (; k < n; ++k) {
+                const float bufOut{ src[k] };
+                const float in{ y[k] };
+                dst[k] = in + bufOut * allPassFeedback;
+                y[k] = bufOut - in;
+            }
+
+            j += n;
+            readIndex = (readIndex + (size_t)n) & allPassMask;
+            writeIndex = (writeIndex + (size_t)n) & allPassMask;
+        }
+    }
+}
+
+} // anonymous namespace
+
+void StereoReverb::reset(const Spec&, State& state)
+{
+    state.combs.fill(0.0f);
+    state.combY.fill(0.0f);
+    state.allPasses.fill(0.0f);
+    state.combIndex = 0;
+    state.allPassIndex = 0;
+}
+
+void StereoReverb::process(const Spec& spec, State& state, const float* inL, const float* inR,
+                           float* outL, float* outR, int numFrames)
+{
+    CombBank combs{ spec, state };
+
+    float* allPassesL{ state.allPasses.data() };
+    float* allPassesR{ allPassesL + numAllPasses * allPassBufferSize };
+
+    size_t combIndex{ state.combIndex };
+    size_t allPassIndex{ state.allPassIndex };
+
+    while (numFrames > 0) {
+        const int n{ std::min(numFrames, maxBlockSize) };
+        int i{ 0 };
+
+        // The output receives the summed comb outputs,
+        // the input frames of the sub-block being read first.
+        while (i < n) {
+            const int m{ (int)std::min((size_t)(n - i), combs.getFramesUntilWrap(combIndex)) };
+            const int end{ i + m };
+
+            for (; i + 4 <= end; i += 4) {
+                combs.processFrames(combIndex, &inL[i], &inR[i], &outL[i], &outR[i]);
+                combIndex = (combIndex + 4) & combMask;
+            }
+
+            // Sub-block tail, or a line wrapping around
+            for (; i < end; ++i) {
+                combs.processFrame(combIndex, inL[i], inR[i], outL[i], outR[i]);
+                combIndex = (combIndex + 1) & combMask;
+            }
+        }
+
+        // normalize due to x8 combs added together 1/8
+        for (int j = 0; j < n; ++j) {
+            outL[j] *= 0.125f;
+            outR[j] *= 0.125f;
+        }
+
+        processAllPasses(allPassesL, allPassIndex, 0, outL, n);
+        processAllPasses(allPassesR, allPassIndex, stereoSpread, outR, n);
+        allPassIndex = (allPassIndex + (size_t)n) & allPassMask;
+
+        inL += n;
+        inR += n;
+        outL += n;
+        outR += n;
+        numFrames -= n;
+    }
+
+    combs.store(state);
+    state.combIndex = combIndex;
+    state.allPassIndex = allPassIndex;
+}
+
+} // namespace dsp
+
+TW_NAMESPACE_END
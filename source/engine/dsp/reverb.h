@@ -6,8 +6,11 @@
 //
 // *****************************************************************************
 
+#pragma once
+
 #include "../globals.h"
 #include "dsp/filters.h"
+#include <array>
 
 TW_NAMESPACE_BEGIN
 
@@ -144,6 +147,54 @@ struct Reverb
 
 };
 
+//==============================================================================
+
+/**
+ * Stereo reverberator.
+ *
+ * This is the same topology and tuning as a pair of Reverb<0> and
+ * Reverb<stereoSpread>, processed in blocks. The sixteen comb filters
+ * of both channels run in the lanes of SIMD vectors. Their delay lines
+ * are stored one after another with a power-of-two length, and share
+ * the same masked write position.
+ */
+struct StereoReverb
+{
+    static constexpr size_t numCombs = 8;
+    static constexpr size_t numAllPasses = 4;
+    static constexpr size_t stereoSpread = 23;
+
+    static constexpr std::array<size_t, numCombs> combTuning{ 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+    static constexpr std::array<size_t, numAllPasses> allPassTuning{ 556, 441, 341, 225 };
+
+    static constexpr size_t combBufferSize = 2048;
+    static constexpr size_t combLineStride = combBufferSize + 16;   ///< Lines are skewed to spread them over the cache sets.
+    static constexpr size_t allPassBufferSize = 1024;
+
+    static_assert(combTuning[numCombs - 1] + stereoSpread <= combBufferSize);
+    static_assert(allPassTuning[0] + stereoSpread <= allPassBufferSize);
+
+    struct Spec
+    {
+        float roomSize{ 0.5f };
+        float damp{ 0.5f };
+    };
+
+    struct State
+    {
+        std::array<float, 2 * numCombs * combLineStride> combs;                 ///< Left then right comb delay lines.
+        std::array<float, 2 * numCombs> combY;                              ///< Comb damping filters.
+        std::array<float, 2 * numAllPasses * allPassBufferSize> allPasses;  ///< Left then right all-pass delay lines.
+        size_t combIndex{ 0 };
+        size_t allPassIndex{ 0 };
+    };
+
+    static void update(Spec&) {}
+    static void reset(const Spec& spec, State& state);
+    static void process(const Spec& spec, State& state, const float* inL, const float* inR,
+                        float* outL, float* outR, int numFrames);
+};
+
 } // namespace dsp
 
 TW_NAMESPACE_END
@@ -8,20 +8,40 @@
 
 #include "engine.h"
 #include "sample.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <thread>
 
 TW_NAMESPACE_BEGIN
 
 Engine::Engine(int numBuses)
     : GlobalEngine::Client()
     , audioBusPool(*this, numBuses)
-    , sampleIdCounter{ 0 }
     , sampleRate{ DEFAULT_SAMPLE_RATE_F }
+    , frameSize{ MIX_BUFFER_NUM_FRAMES }
     , nonRealTime{ false }
+    , numRealtimeRenderThreads{ 1 }
+    , voiceStealing{ VoiceStealing::Oldest }
     , transportInfo{}
     , ccParams(NUM_CC_PARAMETERS, 0.0f)
+    , masterGain()
+    , statsNumBlocks{ 0 }
+    , statsLastBlockTime{ 0.0 }
+    , statsMaxBlockTime{ 0.0 }
+    , statsLoad{ 0.0 }
+    , statsMaxLoad{ 0.0 }
     , midiKeyboardState{}
     , voiceIdCounter{ 0 }
+    , blockFramePos{ 0 }
 {
+    pendingTriggers.reserve(DEFAULT_TRIGGER_BUFFER_SIZE);
+    pendingReleases.reserve(DEFAULT_RELEASE_BUFFER_SIZE);
+    pendingControlChanges.reserve(DEFAULT_CC_BUFFER_SIZE);
+
+    masterGain.setName("master_gain");
+    masterGain.setRange(0.0f, 16.0f); // Allow +24dB gain
+    masterGain.setValue(1.0f, true);
 }
 
 Engine::~Engine() = default;
@@ -37,15 +57,17 @@ void Engine::reset()
 
 void Engine::prepareToPlay(float requestedSampleRate, int requestedFrameSize)
 {
+    assert(requestedFrameSize > 0);
+
     sampleRate = requestedSampleRate;
     frameSize = requestedFrameSize;
 
-    audioBusPool.prepareToPlay();
+    audioBusPool.prepareToPlay(frameSize);
 }
 
 void Engine::prepareToPlay()
 {
-    audioBusPool.prepareToPlay();
+    audioBusPool.prepareToPlay(frameSize);
 }
 
 int Engine::triggerVoice(Trigger trigger)
@@ -63,15 +85,46 @@ int Engine::triggerVoice(Trigger trigger)
     return id;
 }
 
-void Engine::releaseVoice(int voiceId, float releaseTime)
+void Engine::releaseVoice(int voiceId, float releaseTime, int frameOffset)
 {
     Release rel{};
     rel.voiceId = voiceId;
     rel.releaseTime = releaseTime;
+    rel.frameOffset = frameOffset;
 
     releases.send(rel);
 }
 
+void Engine::setNonRealtime(bool nonRT)
+{
+    if (nonRT == nonRealTime)
+        return;
+
+    if (nonRT) {
+        numRealtimeRenderThreads = audioBusPool.getNumRenderThreads();
+        audioBusPool.setNumRenderThreads((int)std::thread::hardware_concurrency());
+    } else {
+        audioBusPool.setNumRenderThreads(numRealtimeRenderThreads);
+    }
+
+    nonRealTime = nonRT;
+}
+
+void Engine::releaseKey(int key, float releaseTime, int frameOffset)
+{
+    Release rel{};
+    rel.key = key;
+    rel.releaseTime = releaseTime;
+    rel.frameOffset = frameOffset;
+
+    releases.send(rel);
+}
+
+void Engine::setVoiceStealing(VoiceStealing policy) noexcept
+{
+    voiceStealing = policy;
+}
+
 void Engine::triggerActuator(const Actuator::Func& f)
 {
     assert(f);
@@ -94,15 +147,138 @@ void Engine::setCC(int index, float v)
         ccParams[index] = v;
 }
 
+void Engine::setCC(int index, float v, int frameOffset)
+{
+    if (index >= 0 && index < NUM_CC_PARAMETERS)
+        controlChanges.send(ControlChange{ index, v, frameOffset });
+}
+
 void Engine::processAudioEvents()
 {
-    // The releases must be processed after the triggers,
-    // otherwise some notes may stuck.
-    processTriggers();
-    processReleases();
+    // Events left over from the previous block keep their
+    // timing relative to the new block start.
+    for (auto& trig : pendingTriggers)
+        trig.frameOffset -= blockFramePos;
+
+    for (auto& rel : pendingReleases)
+        rel.frameOffset -= blockFramePos;
+
+    for (auto& cc : pendingControlChanges)
+        cc.frameOffset -= blockFramePos;
+
+    blockFramePos = 0;
+
+    receiveEvents();
+    processScheduledEvents();
     processActuators();
 }
 
+void Engine::process(float* const* outputs, int numOutputs, int numFrames)
+{
+    assert(outputs != nullptr);
+    assert(numOutputs >= MIX_BUFFER_NUM_CHANNELS);
+
+    const auto start{ std::chrono::steady_clock::now() };
+
+    for (int i = 0; i < numOutputs; ++i)
+        ::memset(outputs[i], 0, sizeof(float) * numFrames);
+
+    // Streams returned in the previous blocks are reused once their
+    // worker is done with them, the offline rendering waits for it.
+    GlobalEngine::getInstance()->getAudioStreamPool().recycleStreams(nonRealTime);
+
+    processAudioEvents();
+    render(outputs, numOutputs, numFrames);
+    applyMasterGain(outputs, numOutputs, numFrames);
+
+    const auto stop{ std::chrono::steady_clock::now() };
+    updateStats(std::chrono::duration<double, std::micro>(stop - start).count(), numFrames);
+}
+
+void Engine::process(float* outL, float* outR, int numFrames)
+{
+    float* outputs[MIX_BUFFER_NUM_CHANNELS]{ outL, outR };
+    process(outputs, MIX_BUFFER_NUM_CHANNELS, numFrames);
+}
+
+Engine::Stats Engine::getStats() const noexcept
+{
+    Stats stats{};
+    stats.numBlocks = statsNumBlocks;
+    stats.lastBlockTime = statsLastBlockTime;
+    stats.maxBlockTime = statsMaxBlockTime;
+    stats.load = statsLoad;
+    stats.maxLoad = statsMaxLoad;
+
+    return stats;
+}
+
+void Engine::resetStats() noexcept
+{
+    statsNumBlocks = 0;
+    statsLastBlockTime = 0.0;
+    statsMaxBlockTime = 0.0;
+    statsLoad = 0.0;
+    statsMaxLoad = 0.0;
+}
+
+void Engine::render(float* const* outputs, int numOutputs, int numFrames)
+{
+    int pos{ 0 };
+
+    while (pos < numFrames) {
+        processScheduledEvents();
+
+        const int n{ std::min({ numFrames - pos, frameSize, getFramesToNextEvent() }) };
+        audioBusPool.processAndMix(outputs, numOutputs, pos, n);
+
+        pos += n;
+        blockFramePos += n;
+    }
+}
+
+void Engine::applyMasterGain(float* const* outputs, int numOutputs, int numFrames)
+{
+    int i{ 0 };
+
+    while (masterGain.isSmoothing() && i < numFrames) {
+        const float gain{ masterGain.getNextValue() };
+
+        for (int ch = 0; ch < numOutputs; ++ch)
+            outputs[ch][i] *= gain;
+
+        ++i;
+    }
+
+    const float gain{ masterGain.getTargetValue() };
+
+    if (gain == 1.0f)
+        return;
+
+    for (int ch = 0; ch < numOutputs; ++ch) {
+        float* out{ outputs[ch] };
+
+        for (int j = i; j < numFrames; ++j)
+            out[j] *= gain;
+    }
+}
+
+void Engine::updateStats(double blockTime, int numFrames) noexcept
+{
+    const double load{ numFrames > 0 ? blockTime * 1e-6 * sampleRate / (double)numFrames : 0.0 };
+
+    statsLastBlockTime = blockTime;
+    statsLoad = load;
+
+    if (blockTime > statsMaxBlockTime)
+        statsMaxBlockTime = blockTime;
+
+    if (load > statsMaxLoad)
+        statsMaxLoad = load;
+
+    ++statsNumBlocks;
+}
+
 int Engine::addSample(const std::string& filePath, int startPos, int stopPos)
 {
     auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
@@ -112,8 +288,9 @@ int Engine::addSample(const std::string& filePath, int startPos, int stopPos)
 
     if (sample != nullptr) {
         std::lock_guard<decltype(mutex)> lock(mutex);
-        id = ++sampleIdCounter;
-        idToSampleMap[id] = sample;
+
+        // IDs start from 1, zero is returned on failure
+        id = samples.append(sample) + 1;
     } else {
         // @todo Report unable to load sample from filePath
     }
@@ -123,13 +300,10 @@ int Engine::addSample(const std::string& filePath, int startPos, int stopPos)
 
 Sample::Ptr Engine::getSampleById(int id)
 {
-    std::lock_guard<decltype(mutex)> lock(mutex);
-    auto it{ idToSampleMap.find(id) };
+    if (const auto* sample{ samples.get(id - 1) })
+        return *sample;
 
-    if (it == idToSampleMap.end())
-        return nullptr;
-
-    return it->second;
+    return nullptr;
 }
 
 static void disposeTrigger(Engine::Trigger& trig)
@@ -143,62 +317,225 @@ static void disposeTrigger(Engine::Trigger& trig)
         g->releaseObject(std::move(trig.modulator));
 }
 
-void Engine::processTriggers()
+void Engine::receiveEvents()
+{
+    Trigger trig{};
+
+    while (triggers.receive(trig)) {
+        if (pendingTriggers.size() < pendingTriggers.capacity())
+            pendingTriggers.push_back(std::move(trig));
+        else
+            disposeTrigger(trig);
+    }
+
+    Release rel{};
+
+    while (releases.receive(rel)) {
+        if (pendingReleases.size() < pendingReleases.capacity())
+            pendingReleases.push_back(rel);
+    }
+
+    ControlChange cc{};
+
+    while (controlChanges.receive(cc)) {
+        if (pendingControlChanges.size() < pendingControlChanges.capacity())
+            pendingControlChanges.push_back(cc);
+        else
+            ccParams[cc.index] = cc.value;
+    }
+}
+
+void Engine::processScheduledEvents()
+{
+    // The releases must be processed after the triggers,
+    // otherwise some notes may stuck.
+    if (!pendingTriggers.empty()) {
+        size_t n{ 0 };
+
+        for (size_t i = 0; i < pendingTriggers.size(); ++i) {
+            auto& trig{ pendingTriggers[i] };
+
+            if (trig.frameOffset <= blockFramePos)
+                processTrigger(trig);
+            else if (i != n++)
+                pendingTriggers[n - 1] = std::move(trig);
+        }
+
+        pendingTriggers.resize(n);
+    }
+
+    if (!pendingReleases.empty()) {
+        size_t n{ 0 };
+
+        for (size_t i = 0; i < pendingReleases.size(); ++i) {
+            auto& rel{ pendingReleases[i] };
+
+            if (rel.frameOffset > blockFramePos || !processRelease(rel))
+                pendingReleases[n++] = rel;
+        }
+
+        pendingReleases.resize(n);
+    }
+
+    if (!pendingControlChanges.empty()) {
+        size_t n{ 0 };
+
+        // Changes of the same parameter are applied in the order they were sent
+        for (size_t i = 0; i < pendingControlChanges.size(); ++i) {
+            const auto& cc{ pendingControlChanges[i] };
+
+            if (cc.frameOffset <= blockFramePos)
+                ccParams[cc.index] = cc.value;
+            else
+                pendingControlChanges[n++] = cc;
+        }
+
+        pendingControlChanges.resize(n);
+    }
+}
+
+int Engine::getFramesToNextEvent() const
+{
+    int offset{ std::numeric_limits<int>::max() };
+
+    for (const auto& trig : pendingTriggers)
+        offset = std::min(offset, trig.frameOffset);
+
+    for (const auto& rel : pendingReleases)
+        offset = std::min(offset, rel.frameOffset);
+
+    for (const auto& cc : pendingControlChanges)
+        offset = std::min(offset, cc.frameOffset);
+
+    return offset == std::numeric_limits<int>::max() ? offset : std::max(1, offset - blockFramePos);
+}
+
+void Engine::processTrigger(Trigger& trig)
 {
     auto* g{ GlobalEngine::getInstance() };
-    auto& samplePool{ g->getSamplePool() };
     auto& streamPool{ g->getAudioStreamPool() };
 
-    Trigger trig{};
+    if (trig.busNumber < 0 || trig.busNumber >= audioBusPool.getNumBuses()) {
+        disposeTrigger(trig);
+        return;
+    }
 
-    while (triggers.receive(trig)) {
-        if (trig.busNumber < 0 || trig.busNumber >= audioBusPool.getNumBuses())
-            continue;
-
-        if (auto sample { getSampleById(trig.sampleId) })
-        {
-            if (sample->isPreloaded()) {
-                if (auto* stream{ streamPool.getStream() }) {
-                    stream->trigger(sample, &g->getStreamWorker());
-
-                    Voice::Trigger voiceTrigger;
-                    voiceTrigger.voiceId   = trig.voiceId;
-                    voiceTrigger.stream    = stream;
-                    voiceTrigger.gain      = trig.gain;
-                    voiceTrigger.tune      = trig.tune;
-                    voiceTrigger.envelope  = std::move(trig.envelope);
-                    voiceTrigger.fxChain   = std::move(trig.fxChain);
-                    voiceTrigger.modulator = std::move(trig.modulator);
-                    stream->setOffset(trig.offset);
-                    stream->setLoop(trig.loopBegin, trig.loopEnd + sample->getStopPosition(), trig.loopXfade);
-
-                    audioBusPool[trig.busNumber].trigger(voiceTrigger);
-                } else {
-                    // No more streams available
+    if (auto sample { getSampleById(trig.sampleId) })
+    {
+        auto& samplePool{ g->getSamplePool() };
+        samplePool.markUsed(*sample);
+
+        // Move a pressed key's sample to the front of the preload queue
+        if (!sample->isPreloaded())
+            samplePool.requestPreload(*sample);
+
+        if (nonRealTime)
+            waitForPreload(*sample);
+
+        if (sample->isPreloaded()) {
+            auto& bus{ audioBusPool[trig.busNumber] };
+            const auto policy{ voiceStealing.load() };
+
+            // Fade out a voice if the bus polyphony is exceeded
+            if (const int polyphony{ bus.getPolyphony() }; polyphony > 0 && bus.getNumPlayingVoices() >= polyphony) {
+                if (auto* voice{ bus.findVoiceToSteal(policy, trig.key, false) })
+                    voice->steal();
+            }
+
+            // Fade out a voice when running short of voices or streams. The reserve
+            // serves the new notes until the stolen voices are over, so that
+            // no voice is cut while its stream is being refilled.
+            const auto isShort = [](int numIdle, int size) {
+                return numIdle <= std::clamp(size / 8, 1, VOICE_STEAL_RESERVE);
+            };
+
+            auto& voicePool{ g->getVoicePool() };
+
+            if (isShort(voicePool.getNumIdleVoices(), voicePool.getSize())
+                || isShort(streamPool.getNumIdleStreams(), streamPool.getSize()))
+                audioBusPool.stealVoice(policy, trig.key);
+
+            if (auto* stream{ streamPool.getStream() }) {
+                // Expected consumption rate, for sizing the stream buffer
+                const float playbackRate{ trig.tune * sample->getAudioFile().getSampleRate() };
+
+                // The offset and the loop must be set before the stream
+                // is handed to the worker.
+                stream->setOffset(trig.offset);
+                stream->setLoop(trig.loopBegin, trig.loopEnd + sample->getStopPosition(), trig.loopXfade);
+                stream->trigger(sample, &g->getStreamWorker(), nonRealTime, playbackRate);
+
+                Voice::Trigger voiceTrigger;
+                voiceTrigger.voiceId   = trig.voiceId;
+                voiceTrigger.stream    = stream;
+                voiceTrigger.gain      = trig.gain;
+                voiceTrigger.tune      = trig.tune;
+                voiceTrigger.key       = trig.key;
+                voiceTrigger.rootKey   = trig.rootKey;
+                voiceTrigger.envelope  = std::move(trig.envelope);
+                voiceTrigger.fxChain   = std::move(trig.fxChain);
+                voiceTrigger.modulator = std::move(trig.modulator);
+
+                if (!bus.trigger(voiceTrigger)) {
+                    stream->returnToPool();
+                    trig.fxChain = std::move(voiceTrigger.fxChain);
+                    trig.modulator = std::move(voiceTrigger.modulator);
                     disposeTrigger(trig);
                 }
+
+                return;
             }
-        } else {
-            // Unable to find sample trig.sampleId
-            disposeTrigger(trig);
         }
     }
+
+    // Unable to find sample trig.sampleId, or no more streams available
+    disposeTrigger(trig);
 }
 
-void Engine::processReleases()
+void Engine::waitForPreload(const Sample& sample)
 {
-    auto& voicePool{ GlobalEngine::getInstance()->getVoicePool() };
+    const auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
 
-    Release rel;
+    while (!sample.isPreloaded() && samplePool.isPreloading())
+        std::this_thread::yield();
+}
 
-    while (releases.receive(rel)) {
-        if (auto* voice{ audioBusPool.findVoiceWithId(rel.voiceId) }) {
+bool Engine::processRelease(Release& rel)
+{
+    if (rel.voiceId < 0) {
+        auto& keyVoices{ audioBusPool.getVoicesForKey(rel.key) };
+        auto* voice{ keyVoices.first() };
+
+        while (voice != nullptr) {
             if (rel.releaseTime < 0.0f)
                 voice->release();
             else
                 voice->releaseWithReleaseTime(rel.releaseTime);
+
+            voice = voice->nextForKey();
         }
+
+        return true;
+    }
+
+    if (auto* voice{ audioBusPool.findVoiceWithId(rel.voiceId) }) {
+        if (rel.releaseTime < 0.0f)
+            voice->release();
+        else
+            voice->releaseWithReleaseTime(rel.releaseTime);
+
+        return true;
     }
+
+    // Keep the release until its voice gets triggered
+    for (const auto& trig : pendingTriggers) {
+        if (trig.voiceId == rel.voiceId) {
+            rel.frameOffset = trig.frameOffset;
+            return false;
+        }
+    }
+
+    return true;
 }
 
 void Engine::processActuators()
@@ -10,13 +10,16 @@
 
 #include "globals.h"
 #include "core/ring_buffer.h"
+#include "core/append_only_table.h"
 #include "dsp/envelope.h"
 #include "global_engine.h"
 #include "audio_bus.h"
 #include "sample.h"
 #include "midi.h"
-#include <map>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
+#include <vector>
 
 TW_NAMESPACE_BEGIN
 
@@ -50,6 +53,7 @@ public:
         int loopXfade   { DEFAULT_XFADE_BUFFER_SIZE };  ///< Loop cross-fade length (in samples).
         float gain      { 1.0f };   ///< Voice gain factor.
         float tune      { 1.0f };   ///< Voice tune (aka playback speed).
+        int frameOffset { 0 };      ///< Frame offset within the current block.
 
         dsp::Envelope::Spec envelope{}; ///< Voice envelope.
 
@@ -64,7 +68,19 @@ public:
     struct Release
     {
         int voiceId { -1 };
+        int key { -1 };             ///< Key to release all the voices of, if no voice ID is given.
         float releaseTime { -1.0f };
+        int frameOffset { 0 };      ///< Frame offset within the current block.
+    };
+
+    /**
+     * Scheduled CC parameter change.
+     */
+    struct ControlChange
+    {
+        int index { -1 };
+        float value { 0.0f };
+        int frameOffset { 0 };      ///< Frame offset within the current block.
     };
 
     /**
@@ -137,8 +153,14 @@ public:
      * Negative release time will cause the voice to release
      * with it's envelope release time, positive value will override the
      * envelope's release.
+     * The frame offset is relative to the start of the next block.
      */
-    void releaseVoice(int voiceId, float releaseTime = -1.0f);
+    void releaseVoice(int voiceId, float releaseTime = -1.0f, int frameOffset = 0);
+
+    /**
+     * Release all the voices playing a key.
+     */
+    void releaseKey(int key, float releaseTime = -1.0f, int frameOffset = 0);
 
     /**
      * Trigger an actuator to be executed on an audio thread.
@@ -149,9 +171,26 @@ public:
      */
     void triggerActuator(const Actuator::Func& f);
 
-    void setNonRealtime(bool nonRT) noexcept { nonRealTime = nonRT; }
+    /**
+     * Switch the non-realtime (offline) rendering on or off.
+     *
+     * In non-realtime mode the streams wait for their data instead of
+     * underrunning, the triggers wait for the samples to be preloaded,
+     * and the buses are rendered in parallel on all the CPU cores.
+     *
+     * @note This must not be called while the audio is being processed.
+     */
+    void setNonRealtime(bool nonRT);
     bool isNonRealtime() const noexcept { return nonRealTime; }
 
+    /**
+     * Set the policy used to choose the voice to steal when a bus polyphony
+     * limit is reached (see AudioBus::setPolyphony) or when there are no more
+     * voices or streams available.
+     */
+    void setVoiceStealing(VoiceStealing policy) noexcept;
+    VoiceStealing getVoiceStealing() const noexcept { return voiceStealing; }
+
     void setTransportInfo(const TransportInfo& info) { transportInfo = info; }
     const TransportInfo& getTransportInfo() const noexcept { return transportInfo; }
 
@@ -159,21 +198,76 @@ public:
     const AudioBusPool& getAudioBusPool() const noexcept { return audioBusPool; }
     float getSampleRate() const noexcept { return sampleRate; }
 
+    /**
+     * Returns the maximum number of frames processed at once.
+     */
+    int getFrameSize() const noexcept { return frameSize; }
+
     std::vector<float>& getCCParameters() noexcept { return ccParams; }
     float getCC(int index) const;
     void setCC(int index, float v);
 
+    /**
+     * Schedule a CC parameter change at a given frame offset
+     * relative to the start of the next block.
+     */
+    void setCC(int index, float v, int frameOffset);
+
     MidiKeyboardState& getMidiKeyboardState() noexcept { return midiKeyboardState; }
     const MidiKeyboardState& getMidiKeyboardState() const noexcept { return midiKeyboardState; }
 
+    /**
+     * Engine processing statistics.
+     */
+    struct Stats
+    {
+        uint64_t numBlocks{};       ///< Number of processed blocks.
+        double lastBlockTime{};     ///< Last block processing time in microseconds.
+        double maxBlockTime{};      ///< Max block processing time in microseconds.
+        double load{};              ///< Last block processing time relative to its duration.
+        double maxLoad{};           ///< Max load.
+    };
+
+    /**
+     * Process a block of audio on the audio thread.
+     *
+     * This processes the pending events, renders all the voices and buses
+     * and applies the master gain. The outputs are stereo pairs: the first
+     * pair is the main output, the following ones are the buses direct outs
+     * (see AudioBus::setOutput). Buses routed to an output that is not
+     * provided are mixed into the main output.
+     *
+     * The events are applied on their exact frame. Events scheduled past
+     * the end of the block are carried over to the next one.
+     * Blocks larger than the prepared frame size are rendered in parts.
+     *
+     * @note This method does not allocate any memory.
+     */
+    void process(float* const* outputs, int numOutputs, int numFrames);
+
+    /**
+     * Process a block of audio into a stereo output.
+     */
+    void process(float* outL, float* outR, int numFrames);
+
     /**
      * Process all pending events on the audio thread.
      *
-     * This method will process all the triggers, releases,
-     * and the actuators. It does not process any audio though.
+     * This method starts a new block: it will process all the triggers,
+     * releases, CC changes due at the block start, and the actuators.
+     * Events with positive frame offsets are kept for the rendering.
+     * It does not process any audio though.
+     *
+     * @note This is called by process().
      */
     void processAudioEvents();
 
+    AudioParameter& getMasterGain() noexcept { return masterGain; }
+    const AudioParameter& getMasterGain() const noexcept { return masterGain; }
+
+    Stats getStats() const noexcept;
+    void resetStats() noexcept;
+
     /**
      * Add a sample to the engine.
      *
@@ -189,39 +283,63 @@ public:
     /**
      * Returns a sample by its ID.
      *
-     * @note This method is thread-safe however it will lock.
+     * @note This method is wait-free, it never blocks on addSample().
      */
     Sample::Ptr getSampleById(int id);
 
 private:
-    void processTriggers();
-    void processReleases();
+    void render(float* const* outputs, int numOutputs, int numFrames);
+    void applyMasterGain(float* const* outputs, int numOutputs, int numFrames);
+    void updateStats(double blockTime, int numFrames) noexcept;
+
+    void receiveEvents();
+    void processScheduledEvents();
+    int getFramesToNextEvent() const;
+    void processTrigger(Trigger& trig);
+    void waitForPreload(const Sample& sample);
+    bool processRelease(Release& rel);
     void processActuators();
     void clearActuators();
 
     AudioBusPool audioBusPool;
 
-    std::mutex mutex;
+    std::mutex mutex;   ///< Serializes the samples addition.
 
-    /// Mapping IDs to samples
-    std::map<int, Sample::Ptr> idToSampleMap;
-    int sampleIdCounter;
+    /// Samples indexed by their ID - 1
+    core::AppendOnlyTable<Sample::Ptr> samples;
 
     float sampleRate;
     int frameSize;
 
     std::atomic<bool> nonRealTime;
+    int numRealtimeRenderThreads;   ///< Render threads to restore when going back to realtime.
+    std::atomic<VoiceStealing> voiceStealing;
 
     TransportInfo transportInfo;
 
     std::vector<float> ccParams;
 
+    AudioParameter masterGain;
+
+    std::atomic<uint64_t> statsNumBlocks;
+    std::atomic<double> statsLastBlockTime;
+    std::atomic<double> statsMaxBlockTime;
+    std::atomic<double> statsLoad;
+    std::atomic<double> statsMaxLoad;
+
     MidiKeyboardState midiKeyboardState;
 
     int voiceIdCounter;
     core::RingBuffer<Trigger, DEFAULT_TRIGGER_BUFFER_SIZE> triggers;
     core::RingBuffer<Release, DEFAULT_RELEASE_BUFFER_SIZE> releases;
+    core::RingBuffer<ControlChange, DEFAULT_CC_BUFFER_SIZE> controlChanges;
     core::RingBuffer<Actuator::Ptr, DEFAULT_ACTUATOR_BUFFER_SUZE> actuators;
+
+    // Events waiting for their frame offset (audio thread only)
+    std::vector<Trigger> pendingTriggers;
+    std::vector<Release> pendingReleases;
+    std::vector<ControlChange> pendingControlChanges;
+    int blockFramePos;  ///< Frames rendered since the block start.
 };
 
 
@@ -8,6 +8,7 @@
 
 #include "fx/delay.h"
 #include "engine.h"
+#include <algorithm>
 #include <cmath>
 
 TW_NAMESPACE_BEGIN
@@ -41,14 +42,71 @@ Delay::Delay()
 
 void Delay::prepareToPlay()
 {
+    const auto& arena{ engine->getGlobalEngine()->getMemoryArena() };
     const auto delayLength{ (int)std::ceilf(engine->getSampleRate() * params[MAX_DELAY].getTargetValue()) };
-    delayL.resize(delayLength);
-    delayR.resize(delayLength);
+    delayL.prepare(arena, delayLength);
+    delayR.prepare(arena, delayLength);
 
     delayToSampleIndex = (float)delayL.getLength() / params[MAX_DELAY].getTargetValue();
 }
 
 void Delay::process(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
+{
+    float dry[blockSize];
+    float wet[blockSize];
+    float delay[blockSize];
+    float fb[blockSize];
+    float l[blockSize];
+    float r[blockSize];
+    float feedL[blockSize];
+    float feedR[blockSize];
+
+    while (numFrames > 0) {
+        // The frames of a block are read before any of them is written,
+        // so a block cannot be longer than the delay. The delay is smoothed
+        // towards its target, so it stays above the lower of both.
+        const float minDelay{ std::min(params[DELAY].getCurrentValue(), params[DELAY].getTargetValue()) * delayToSampleIndex };
+
+        if (minDelay < (float)minBlockSize) {
+            processFrames(inL, inR, outL, outR, numFrames);
+            return;
+        }
+
+        const int n{ std::min({ (int)minDelay, numFrames, blockSize }) };
+
+        params[DRY].getValues(dry, n);
+        params[WET].getValues(wet, n);
+        params[DELAY].getValues(delay, n);
+        params[FEEDBACK].getValues(fb, n);
+
+        for (int i = 0; i < n; ++i)
+            delay[i] *= delayToSampleIndex;
+
+        delayL.readBlock(delay, l, n);
+        delayR.readBlock(delay, r, n);
+
+        for (int i = 0; i < n; ++i) {
+            feedL[i] = l[i] * fb[i] + inL[i];
+            feedR[i] = r[i] * fb[i] + inR[i];
+        }
+
+        delayL.writeBlock(feedL, n);
+        delayR.writeBlock(feedR, n);
+
+        for (int i = 0; i < n; ++i) {
+            outL[i] = l[i] * wet[i] + inL[i] * dry[i];
+            outR[i] = r[i] * wet[i] + inR[i] * dry[i];
+        }
+
+        inL += n;
+        inR += n;
+        outL += n;
+        outR += n;
+        numFrames -= n;
+    }
+}
+
+void Delay::processFrames(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
 {
     for (int i = 0; i < numFrames; ++i) {
         const float dry{ params[DRY].getNextValue() };
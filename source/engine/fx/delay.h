@@ -43,6 +43,13 @@ public:
 private:
 
     constexpr static float maxDelayInSeconds{ 10.0f };
+    constexpr static int blockSize{ 32 };
+    constexpr static int minBlockSize{ 8 };     ///< Shorter delays are run frame by frame.
+
+    /**
+     * Process the frames one by one, for delays shorter than a block.
+     */
+    void processFrames(const float* inL, const float* inR, float* outL, float* outR, int numFrames);
 
     dsp::DelayLine delayL;
     dsp::DelayLine delayR;
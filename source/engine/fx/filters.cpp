@@ -8,6 +8,7 @@
 
 #include "engine.h"
 #include "fx/filters.h"
+#include <algorithm>
 
 TW_NAMESPACE_BEGIN
 
@@ -15,6 +16,7 @@ namespace fx {
 
 constexpr float defaultFrequency = 10000.0f;
 constexpr float defaultQ = 0.7071f;
+constexpr int smoothingBlockSize = 32;
 
 static void updateFilter(dsp::BiquadFilter::Spec& spec, float f, float q)
 {
@@ -51,27 +53,35 @@ void BiquadFilter::prepareToPlay()
 
 void BiquadFilter::process(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
 {
-    float f = params[FREQUENCY].getNextValue();
-    float q = params[Q_FACTOR].getNextValue();
-
+    // While the parameters are smoothing the coefficients are only computed
+    // at the end of each sub-block and interpolated in between.
     while ((params[FREQUENCY].isSmoothing() ||
             params[Q_FACTOR].isSmoothing()) && numFrames > 0) {
 
-        f = params[FREQUENCY].getNextValue();
-        q = params[Q_FACTOR].getNextValue();
+        const int n{ std::min(numFrames, smoothingBlockSize) };
+        float f{ 0.0f };
+        float q{ 0.0f };
 
-        updateFilter(spec, f, q);
+        for (int i = 0; i < n; ++i) {
+            f = params[FREQUENCY].getNextValue();
+            q = params[Q_FACTOR].getNextValue();
+        }
 
-        *(outL++) = dsp::BiquadFilter::tick(spec, filterL, *(inL++));
-        *(outR++) = dsp::BiquadFilter::tick(spec, filterR, *(inR++));
+        auto target{ spec };
+        updateFilter(target, f, q);
 
-        --numFrames;
-    }
+        dsp::BiquadFilter::processStereo(spec, target, filterL, filterR, inL, inR, outL, outR, n);
+        spec = target;
 
-    if (numFrames > 0) {
-        dsp::BiquadFilter::process(spec, filterL, inL, outL, numFrames);
-        dsp::BiquadFilter::process(spec, filterR, inR, outR, numFrames);
+        inL += n;
+        inR += n;
+        outL += n;
+        outR += n;
+        numFrames -= n;
     }
+
+    if (numFrames > 0)
+        dsp::BiquadFilter::processStereo(spec, filterL, filterR, inL, inR, outL, outR, numFrames);
 }
 
 int BiquadFilter::getTailLength() const
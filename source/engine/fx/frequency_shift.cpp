@@ -9,6 +9,7 @@
 #include "fx/frequency_shift.h"
 #include "core/math.h"
 #include "engine.h"
+#include <algorithm>
 
 TW_NAMESPACE_BEGIN
 
@@ -28,48 +29,65 @@ void FrequencyShift::prepareToPlay()
 {
     hilbertSpec.sampleRate = engine->getSampleRate();
     dsp::Hilbert::update(hilbertSpec);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateL);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateR);
+    dsp::Hilbert::reset(hilbertSpec, hilbertState);
 
-    phase = 0.0f;
+    frequency = params[FREQUENCY].getCurrentValue();
+    oscillatorSpec.increment = frequency * core::math::Constants<float>::twoPi / engine->getSampleRate();
+    dsp::QuadratureOscillator::update(oscillatorSpec);
+    dsp::QuadratureOscillator::reset(oscillatorSpec, oscillatorState);
 }
 
 void FrequencyShift::process(const float* inL, const float* inR, float *outL, float* outR, int numFrames)
 {
+    // While the frequency is smoothing, the oscillator is updated once per block
+    constexpr int blockSize{ 32 };
+
     const float k{ core::math::Constants<float>::twoPi / engine->getSampleRate() };
-    float f{ params[FREQUENCY].getNextValue() };
-    float df{ f * k };
 
-    while (params[FREQUENCY].isSmoothing() && numFrames > 0) {
-        f = params[FREQUENCY].getNextValue();
-        df = f * k;
+    core::Float4 re[blockSize];
+    core::Float4 im[blockSize];
+    float c[blockSize];
+    float s[blockSize];
 
-        const auto l{ dsp::Hilbert::tick(hilbertSpec, hilbertStateL, *(inL++)) };
-        const auto r{ dsp::Hilbert::tick(hilbertSpec, hilbertStateR, *(inR++)) };
+    while (numFrames > 0) {
+        const int n{ std::min(numFrames, blockSize) };
 
-        const auto c { std::cos(phase) };
-        const auto s { std::sin(phase) };
-        phase += df;
+        float f{ params[FREQUENCY].getCurrentValue() };
 
-        *(outL++) = l.real() * c + l.imag() * s;
-        *(outR++) = r.real() * c + r.imag() * s;
+        // The average frequency keeps the phase in line with the smoothed parameter
+        if (params[FREQUENCY].isSmoothing()) {
+            f = 0.0f;
 
-        --numFrames;
-    }
+            for (int i = 0; i < n; ++i)
+                f += params[FREQUENCY].getNextValue();
+
+            f /= (float)n;
+        }
+
+        if (f != frequency) {
+            frequency = f;
+            oscillatorSpec.increment = f * k;
+            dsp::QuadratureOscillator::update(oscillatorSpec);
+        }
 
-    while (numFrames > 0)
-    {
-        const auto l{ dsp::Hilbert::tick(hilbertSpec, hilbertStateL, *(inL++)) };
-        const auto r{ dsp::Hilbert::tick(hilbertSpec, hilbertStateR, *(inR++)) };
+        for (int i = 0; i < n; ++i)
+            im[i] = core::Float4::set(inL[i], inR[i], 0.0f, 0.0f);
 
-        const auto c { std::cos(phase) };
-        const auto s { std::sin(phase) };
-        phase += df;
+        dsp::Hilbert::process(hilbertSpec, hilbertState, im, re, im, n);
+        dsp::QuadratureOscillator::process(oscillatorSpec, oscillatorState, c, s, n);
 
-        *(outL++) = l.real() * c + l.imag() * s;
-        *(outR++) = r.real() * c + r.imag() * s;
+        for (int i = 0; i < n; ++i) {
+            float y[4];
+            (re[i] * core::Float4::fill(c[i]) + im[i] * core::Float4::fill(s[i])).store(y);
+            outL[i] = y[0];
+            outR[i] = y[1];
+        }
 
-        --numFrames;
+        inL += n;
+        inR += n;
+        outL += n;
+        outR += n;
+        numFrames -= n;
     }
 }
 
@@ -11,6 +11,7 @@
 #include "../globals.h"
 #include "audio_effect.h"
 #include "dsp/hilbert.h"
+#include "dsp/oscillator.h"
 
 TW_NAMESPACE_BEGIN
 
@@ -39,10 +40,11 @@ public:
 private:
 
     dsp::Hilbert::Spec hilbertSpec;
-    dsp::Hilbert::State hilbertStateL;
-    dsp::Hilbert::State hilbertStateR;
+    dsp::Hilbert::VectorState hilbertState;     ///< Left and right channels in the first lanes.
 
-    float phase{};
+    float frequency{};                          ///< Oscillator frequency.
+    dsp::QuadratureOscillator::Spec oscillatorSpec;
+    dsp::QuadratureOscillator::State oscillatorState;
 };
 
 } // namespace fx
@@ -9,6 +9,7 @@
 #include "fx/pitch_shift.h"
 #include "core/math.h"
 #include "engine.h"
+#include <algorithm>
 
 TW_NAMESPACE_BEGIN
 
@@ -18,6 +19,7 @@ namespace design {
 
 constexpr float lowPassOpenFreq{ 22000.0f };
 constexpr float bufferLengthMs{ 50.0f };
+constexpr int blockSize{ 32 };
 
 } // namespace design
 
@@ -53,15 +55,15 @@ void PitchShift::prepareToPlay()
     float nq{ 0.5f * sampleRate};
 
     int numSamples{ static_cast<int>(sampleRate * design::bufferLengthMs / 1000.0f) };
-    delayL.resize(numSamples);
-    delayR.resize(numSamples);
+
+    // The block reads go up to a block past the longest delay
+    const auto& arena{ engine->getGlobalEngine()->getMemoryArena() };
+    delayL.prepare(arena, numSamples + design::blockSize);
+    delayR.prepare(arena, numSamples + design::blockSize);
 
     hilbertSpec.sampleRate = sampleRate;
     dsp::Hilbert::update(hilbertSpec);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateLA);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateRA);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateLB);
-    dsp::Hilbert::reset(hilbertSpec, hilbertStateRB);
+    dsp::Hilbert::reset(hilbertSpec, hilbertState);
 
     phaseA = 0.0f;
     phaseB = 0.0f;
@@ -74,61 +76,129 @@ void PitchShift::prepareToPlay()
     dB = 0.5f * numSamples;
     w = core::math::Constants<float>::pi / (float)numSamples;
 
+    windowRate = 1.0f - params[PITCH].getCurrentValue();
+    windowSpec.increment = w * windowRate;
+    dsp::QuadratureOscillator::update(windowSpec);
+    dsp::QuadratureOscillator::reset(windowSpec, windowState, w * dA);
+
     delayL.reset();
     delayR.reset();
 }
 
 void PitchShift::process(const float* inL, const float* inR, float *outL, float* outR, int numFrames)
 {
+    using core::Float4;
+
     // Update the low-pass filter once per processing block only.
     if (params[PITCH].isSmoothing())
         updateLowPassFilter();
 
     const float delayLength{ (float)delayL.getLength() };
 
-    for (int i = 0; i < numFrames; ++i) {
-        const float p{ 1.0f - params[PITCH].getNextValue() };
-
-        float l{ dsp::BiquadFilter::tick(lowPassSpec, lowPassStateL, dsp::DCBlockFilter::tick(dcBlockSpec, dcBlockStateL, inL[i])) };
-        float r{ dsp::BiquadFilter::tick(lowPassSpec, lowPassStateR, dsp::DCBlockFilter::tick(dcBlockSpec, dcBlockStateR, inR[i])) };
+    float p[design::blockSize];
+    float l[design::blockSize];
+    float r[design::blockSize];
+    float lb[design::blockSize];
+    float rb[design::blockSize];
+    float delayA[design::blockSize];
+    float delayB[design::blockSize];
+    Float4 re[design::blockSize];
+    Float4 im[design::blockSize];
+    Float4 kr[design::blockSize];
+    Float4 ki[design::blockSize];
+
+    while (numFrames > 0) {
+        const int n{ std::min(numFrames, design::blockSize) };
+
+        // The windows follow the average rate over the block while smoothing,
+        // which brings them back in phase with dA at the end of the block.
+        float rate{ 1.0f - params[PITCH].getCurrentValue() };
+
+        if (params[PITCH].isSmoothing()) {
+            rate = 0.0f;
+
+            for (int i = 0; i < n; ++i) {
+                p[i] = 1.0f - params[PITCH].getNextValue();
+                rate += p[i];
+            }
+
+            rate /= (float)n;
+        } else {
+            std::fill(p, p + n, rate);
+        }
 
-        delayL.write(l);
-        delayR.write(r);
+        if (rate != windowRate) {
+            windowRate = rate;
+            windowSpec.increment = w * rate;
+            dsp::QuadratureOscillator::update(windowSpec);
+        }
 
-        const float wa{ std::sin(w * dA) };
-        const float wb{ std::sin(w * dB) };
+        dsp::DCBlockFilter::process(dcBlockSpec, dcBlockStateL, inL, l, n);
+        dsp::DCBlockFilter::process(dcBlockSpec, dcBlockStateR, inR, r, n);
+        dsp::BiquadFilter::processStereo(lowPassSpec, lowPassStateL, lowPassStateR, l, r, l, r, n);
+
+        delayL.writeBlock(l, n);
+        delayR.writeBlock(r, n);
+
+        // Delays are read once the whole block is written
+        const float readOffset{ (float)(n - 1) };
+
+        for (int i = 0; i < n; ++i) {
+            float wb, wa;
+            dsp::QuadratureOscillator::tick(windowSpec, windowState, wb, wa);
+            wb = std::abs(wb);
+
+            delayA[i] = dA + readOffset;
+            delayB[i] = dB + readOffset;
+
+            // Windowed rotation applied to the quadrature pairs
+            kr[i] = Float4::set(wa * cosA, wa * cosA, wb * cosB, wb * cosB);
+            ki[i] = Float4::set(wa * sinA, wa * sinA, wb * sinB, wb * sinB);
+
+            dA += p[i];
+            dB += p[i];
+
+            if (dA < 0.0f) {
+                dA += delayLength;
+                updatePhaseA();
+            } else if (dA >= delayLength) {
+                dA -= delayLength;
+                updatePhaseA();
+            }
+
+            if (dB < 0.0f) {
+                dB += delayLength;
+                updatePhaseB();
+            } else if (dB >= delayLength) {
+                dB -= delayLength;
+                updatePhaseB();
+            }
+        }
 
-        auto hla = dsp::Hilbert::tick(hilbertSpec, hilbertStateLA, delayL.read(dA));
-        auto hra = dsp::Hilbert::tick(hilbertSpec, hilbertStateRA, delayR.read(dA));
-        auto hlb = dsp::Hilbert::tick(hilbertSpec, hilbertStateLB, delayL.read(dB));
-        auto hrb = dsp::Hilbert::tick(hilbertSpec, hilbertStateRB, delayR.read(dB));
+        dsp::QuadratureOscillator::normalize(windowState);
 
-        float la = hla.real() * cosA - hla.imag() * sinA;
-        float ra = hra.real() * cosA - hra.imag() * sinA;
-        float lb = hlb.real() * cosB - hlb.imag() * sinB;
-        float rb = hrb.real() * cosB - hrb.imag() * sinB;
+        delayL.readBlock(delayA, l, n);
+        delayR.readBlock(delayA, r, n);
+        delayL.readBlock(delayB, lb, n);
+        delayR.readBlock(delayB, rb, n);
 
-        outL[i] = wa * la + wb * lb;
-        outR[i] = wa * ra + wb * rb;
+        for (int i = 0; i < n; ++i)
+            re[i] = Float4::set(l[i], r[i], lb[i], rb[i]);
 
-        dA += p;
-        dB += p;
+        dsp::Hilbert::process(hilbertSpec, hilbertState, re, re, im, n);
 
-        if (dA < 0.0f) {
-            dA += delayLength;
-            updatePhaseA();
-        } else if (dA >= delayLength) {
-            dA -= delayLength;
-            updatePhaseA();
+        for (int i = 0; i < n; ++i) {
+            float y[4];
+            (re[i] * kr[i] - im[i] * ki[i]).store(y);
+            outL[i] = y[0] + y[2];
+            outR[i] = y[1] + y[3];
         }
 
-        if (dB < 0.0f) {
-            dB += delayLength;
-            updatePhaseB();
-        } else if (dB >= delayLength) {
-            dB -= delayLength;
-            updatePhaseB();
-        }
+        inL += n;
+        inR += n;
+        outL += n;
+        outR += n;
+        numFrames -= n;
     }
 }
 
@@ -148,6 +218,9 @@ void PitchShift::updatePhaseA()
     const float a{ core::math::Constants<float>::twoPi * phaseA };
     cosA = cos(a);
     sinA = sin(a);
+
+    // Rewind the windows as dA has jumped by a whole window period
+    dsp::QuadratureOscillator::reset(windowSpec, windowState, w * dA);
 }
 
 void PitchShift::updatePhaseB()
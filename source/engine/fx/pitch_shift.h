@@ -13,6 +13,7 @@
 #include "dsp/delay_line.h"
 #include "dsp/filters.h"
 #include "dsp/hilbert.h"
+#include "dsp/oscillator.h"
 
 TW_NAMESPACE_BEGIN
 
@@ -60,10 +61,7 @@ private:
     dsp::DCBlockFilter::State dcBlockStateR;
 
     dsp::Hilbert::Spec hilbertSpec;
-    dsp::Hilbert::State hilbertStateLA;
-    dsp::Hilbert::State hilbertStateRA;
-    dsp::Hilbert::State hilbertStateLB;
-    dsp::Hilbert::State hilbertStateRB;
+    dsp::Hilbert::VectorState hilbertState;     ///< Left A, right A, left B and right B in the lanes.
 
     float phaseA;
     float phaseB;
@@ -73,6 +71,12 @@ private:
     float dA;
     float dB;
     float w;
+
+    // The cross-fade windows are sin(w * dA) and sin(w * dB) = |cos(w * dA)|,
+    // generated by an oscillator that is rewound when dA wraps around.
+    float windowRate;
+    dsp::QuadratureOscillator::Spec windowSpec;
+    dsp::QuadratureOscillator::State windowState;
 };
 
 } // namespace fx
@@ -7,6 +7,7 @@
 // *****************************************************************************
 
 #include "fx/reverb.h"
+#include "engine.h"
 #include <cassert>
 
 TW_NAMESPACE_BEGIN
@@ -53,21 +54,16 @@ Reverb::Reverb()
     params[FEEDBACK].setRange(0.0f, 1.0f);
     params[FEEDBACK].setValue(defaults::feedback, true);
 
-    reverbLSpec.roomSize = defaults::roomSize;
-    reverbLSpec.damp = defaults::damp;
-
-    reverbRSpec.roomSize = defaults::roomSize;
-    reverbRSpec.damp = defaults::damp;
+    reverbSpec.roomSize = defaults::roomSize;
+    reverbSpec.damp = defaults::damp;
 }
 
 void Reverb::prepareToPlay()
 {
-    ReverbL::update(reverbLSpec);
-    ReverbR::update(reverbRSpec);
-
-    ReverbL::reset(reverbLSpec, reverbLState);
-    ReverbR::reset(reverbRSpec, reverbRState);
+    dsp::StereoReverb::update(reverbSpec);
+    dsp::StereoReverb::reset(reverbSpec, reverbState);
 
+    intermediateBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, engine->getFrameSize());
     intermediateBuffer.clear();
 
     pitchShift.setEngine(engine);
@@ -78,7 +74,7 @@ void Reverb::prepareToPlay()
 
 void Reverb::process(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
 {
-    assert(numFrames <= MIX_BUFFER_NUM_FRAMES);
+    assert(numFrames <= intermediateBuffer.getNumFrames());
 
     update();
 
@@ -98,12 +94,10 @@ void Reverb::process(const float* inL, const float* inR, float* outL, float* out
             tmpR[i] = inR[i] + feedback * tmpR[i];
         }
 
-        ReverbL::process(reverbLSpec, reverbLState, tmpL, tmpL, numFrames);
-        ReverbR::process(reverbRSpec, reverbRState, tmpR, tmpR, numFrames);
+        dsp::StereoReverb::process(reverbSpec, reverbState, tmpL, tmpR, tmpL, tmpR, numFrames);
     } else {
         // Normal reverb
-        ReverbL::process(reverbLSpec, reverbLState, inL, tmpL, numFrames);
-        ReverbR::process(reverbRSpec, reverbRState, inR, tmpR, numFrames);
+        dsp::StereoReverb::process(reverbSpec, reverbState, inL, inR, tmpL, tmpR, numFrames);
     }
 
     // Dry/wet mixing
@@ -132,14 +126,10 @@ int Reverb::getTailLength() const
 
 void Reverb::update()
 {
-    reverbLSpec.roomSize = params[ROOM_SIZE].getTargetValue();
-    reverbLSpec.damp = params[DAMP].getTargetValue();
-
-    reverbRSpec.roomSize = params[ROOM_SIZE].getTargetValue();
-    reverbRSpec.damp = params[DAMP].getTargetValue();
+    reverbSpec.roomSize = params[ROOM_SIZE].getTargetValue();
+    reverbSpec.damp = params[DAMP].getTargetValue();
 
-    ReverbL::update(reverbLSpec);
-    ReverbR::update(reverbRSpec);
+    dsp::StereoReverb::update(reverbSpec);
 }
 
 } // namespace fx
@@ -49,16 +49,8 @@ private:
 
     void update();
 
-    static constexpr int stereoSpread = 23;
-
-    using ReverbL = dsp::Reverb<0>;
-    using ReverbR = dsp::Reverb<stereoSpread>;
-
-    ReverbL::Spec reverbLSpec;
-    ReverbR::Spec reverbRSpec;
-
-    ReverbL::State reverbLState;
-    ReverbR::State reverbRState;
+    dsp::StereoReverb::Spec reverbSpec;
+    dsp::StereoReverb::State reverbState;
 
     core::AudioBuffer<float> intermediateBuffer;
     fx::PitchShift pitchShift;
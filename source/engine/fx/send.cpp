@@ -57,6 +57,11 @@ void Send::process(const float* inL, const float* inR, float* outL, float* outR,
     }
 }
 
+int Send::getLinkedBus() const
+{
+    return (int)params[BUS].getTargetValue();
+}
+
 } // namespace fx
 
 TW_NAMESPACE_END
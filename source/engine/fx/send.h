@@ -38,6 +38,7 @@ public:
     void prepareToPlay() override;
     void process(const float* inL, const float* inR, float* outL, float* outR, int numFrames) override;
     int getTailLength() const override { return 0; }
+    int getLinkedBus() const override;
 
 private:
 
@@ -9,6 +9,7 @@
 #include "fx/vocoder.h"
 #include "core/math.h"
 #include "engine.h"
+#include <algorithm>
 #include <cassert>
 
 TW_NAMESPACE_BEGIN
@@ -28,7 +29,7 @@ constexpr float filterGainCompensation = 128.0f;
 
 void FilterBank::update(float sampleRate)
 {
-    const float k{ core::math::Constants<float>::pi / sampleRate };
+    std::array<dsp::BiquadFilter::Spec, NUM_BANDS> specs{};
 
     for (size_t i = 0; i < specs.size(); ++i) {
         const float lf{ i == 0 ? 63.0f : powf(bandFreq[i - 1] * bandFreq[i], 0.5f) };
@@ -40,17 +41,118 @@ void FilterBank::update(float sampleRate)
         specs[i].q = q;
         dsp::BiquadFilter::update(specs[i]);
     }
+
+    for (size_t g = 0; g < groups.size(); ++g) {
+        const auto* spec{ &specs[g * 4] };
+        const auto b = [spec](int k) { return core::Float4::set(spec[0].b[k], spec[1].b[k], spec[2].b[k], spec[3].b[k]); };
+        const auto a = [spec](int k) { return core::Float4::set(spec[0].a[k], spec[1].a[k], spec[2].a[k], spec[3].a[k]); };
+
+        groups[g].b0 = b(0);
+        groups[g].b1 = b(1);
+        groups[g].b2 = b(2);
+        groups[g].a1 = a(1);
+        groups[g].a2 = a(2);
+    }
 }
 
 void FilterBank::reset()
 {
-    for (size_t i = 0; i < states.size(); ++i)
-        dsp::BiquadFilter::reset(specs[i], states[i]);
+    const auto zero{ core::Float4::fill(0.0f) };
+
+    for (auto& group : groups) {
+        group.x[0] = group.x[1] = zero;
+        group.y[0] = group.y[1] = zero;
+    }
+}
+
+void FilterBank::process(size_t group, const float* in, core::Float4* out, int numFrames)
+{
+    assert(group < groups.size());
+
+    auto& g{ groups[group] };
+
+    core::Float4 x0{ g.x[0] };
+    core::Float4 x1{ g.x[1] };
+    core::Float4 y0{ g.y[0] };
+    core::Float4 y1{ g.y[1] };
+
+    // Same operations order as dsp::BiquadFilter::tick()
+    for (int i = 0; i < numFrames; ++i) {
+        const auto x{ core::Float4::fill(in[i]) };
+        const auto y{ g.b0 * x + g.b1 * x0 + g.b2 * x1 - g.a1 * y0 - g.a2 * y1 };
+
+        x1 = x0;
+        x0 = x;
+        y1 = y0;
+        y0 = y;
+
+        out[i] = y;
+    }
+
+    g.x[0] = x0;
+    g.x[1] = x1;
+    g.y[0] = y0;
+    g.y[1] = y1;
+}
+
+/**
+ * Store the frames of a group of bands (bands in the lanes)
+ * to the bands channels of a buffer.
+ */
+static void storeBands(const core::Float4* frames, core::AudioBuffer<float>& buffer, size_t group, int numFrames)
+{
+    float* rows[4];
+
+    for (size_t k = 0; k < 4; ++k)
+        rows[k] = buffer.getChannelData((int)(group * 4 + k));
+
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        auto v0{ frames[i] }, v1{ frames[i + 1] }, v2{ frames[i + 2] }, v3{ frames[i + 3] };
+        core::Float4::transpose(v0, v1, v2, v3);
+        v0.store(&rows[0][i]);
+        v1.store(&rows[1][i]);
+        v2.store(&rows[2][i]);
+        v3.store(&rows[3][i]);
+    }
+
+    for (; i < numFrames; ++i) {
+        float tmp[4];
+        frames[i].store(tmp);
+
+        for (size_t k = 0; k < 4; ++k)
+            rows[k][i] = tmp[k];
+    }
 }
 
-float FilterBank::tick(int band, float in)
+/**
+ * Load the bands channels of a buffer to the frames
+ * of a group of bands (bands in the lanes).
+ */
+static void loadBands(const core::AudioBuffer<float>& buffer, size_t group, core::Float4* frames, int numFrames)
 {
-    return dsp::BiquadFilter::tick(specs[band], states[band], in);
+    const float* rows[4];
+
+    for (size_t k = 0; k < 4; ++k)
+        rows[k] = buffer.getChannelData((int)(group * 4 + k));
+
+    int i{ 0 };
+
+    for (; i + 4 <= numFrames; i += 4) {
+        auto v0{ core::Float4::load(&rows[0][i]) };
+        auto v1{ core::Float4::load(&rows[1][i]) };
+        auto v2{ core::Float4::load(&rows[2][i]) };
+        auto v3{ core::Float4::load(&rows[3][i]) };
+        core::Float4::transpose(v0, v1, v2, v3);
+        frames[i] = v0;
+        frames[i + 1] = v1;
+        frames[i + 2] = v2;
+        frames[i + 3] = v3;
+    }
+
+    for (; i < numFrames; ++i)
+        frames[i] = core::Float4::set(rows[0][i], rows[1][i], rows[2][i], rows[3][i]);
 }
 
 } // namespace vocoder
@@ -62,6 +164,7 @@ const std::string VocoderAnalyzer::tag("vocoder_analyzer");
 VocoderAnalyzer::VocoderAnalyzer()
     : AudioEffect()
     , envelope(vocoder::NUM_BANDS, MIX_BUFFER_NUM_FRAMES)
+    , monoBuffer(1, MIX_BUFFER_NUM_FRAMES)
 {
 }
 
@@ -79,31 +182,38 @@ void VocoderAnalyzer::prepareToPlay()
     for (auto& state : hilbertStates)
         dsp::Hilbert::reset(hilbertSpec, state);
 
+    envelope.allocate(vocoder::NUM_BANDS, engine->getFrameSize());
     envelope.clear();
+    monoBuffer.allocate(1, engine->getFrameSize());
+    bandBuffer.resize((size_t)engine->getFrameSize());
 }
 
 void VocoderAnalyzer::process(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
 {
-    assert(numFrames <= MIX_BUFFER_NUM_FRAMES);
+    assert(numFrames <= envelope.getNumFrames());
 
     if (inL != outL)
         ::memcpy(outL, inL, sizeof(float) * numFrames);
     if (inR != outR)
         ::memcpy(outR, inR, sizeof(float) * numFrames);
 
-    std::array<float, MIX_BUFFER_NUM_FRAMES> tmp;
+    float* tmp{ monoBuffer.getChannelData(0) };
     for (int i = 0; i < numFrames; ++i)
         tmp[i] = 0.5f * (inL[i] + inR[i]);
 
-    for (int band = 0; band < vocoder::NUM_BANDS; ++band) {
-        float* env{ envelope.getChannelData(band) };
+    const auto one{ core::Float4::fill(1.0f) };
+    const auto compensation{ core::Float4::fill(vocoder::filterGainCompensation) };
 
-        for (int i = 0; i < numFrames; ++i) {
-            const float x{ filterBank.tick(band, tmp[i]) };
-            const auto y{ dsp::Hilbert::tick(hilbertSpec, hilbertStates[band], x) };
+    auto* bands{ bandBuffer.data() };
 
-            env[i] = std::min(1.0f, std::abs(y)) * vocoder::filterGainCompensation;
-        }
+    for (size_t group = 0; group < vocoder::NUM_BAND_GROUPS; ++group) {
+        filterBank.process(group, tmp, bands, numFrames);
+        dsp::Hilbert::processMagnitude(hilbertSpec, hilbertStates[group], bands, bands, numFrames);
+
+        for (int i = 0; i < numFrames; ++i)
+            bands[i] = core::Float4::min(one, bands[i]) * compensation;
+
+        vocoder::storeBands(bands, envelope, group, numFrames);
     }
 }
 
@@ -114,6 +224,7 @@ const std::string VocoderSynthesizer::tag("vocoder_synthesizer");
 VocoderSynthesizer::VocoderSynthesizer()
     : AudioEffect(NUM_PARAMS)
     , analyzer{ nullptr }
+    , inputBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
 {
     params[ANALYZER_BUS].setName("analyzer_bus");
     params[ANALYZER_BUS].setValue(0.0f, true);
@@ -135,6 +246,10 @@ void VocoderSynthesizer::prepareToPlay()
     filterBankL.reset();
     filterBankR.reset();
 
+    inputBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, engine->getFrameSize());
+    bandBuffer.resize((size_t)engine->getFrameSize() * 2);
+    mixBuffer.resize((size_t)engine->getFrameSize() * 2);
+
     // Looking for the analyzer
     int bus{ (int) params[ANALYZER_BUS].getTargetValue() };
 
@@ -156,7 +271,7 @@ void VocoderSynthesizer::prepareToPlay()
 
 void VocoderSynthesizer::process(const float* inL, const float* inR, float* outL, float* outR, int numFrames)
 {
-    assert(numFrames <= MIX_BUFFER_NUM_FRAMES);
+    assert(numFrames <= inputBuffer.getNumFrames());
 
     if (analyzer == nullptr) {
         if (inL != outL)
@@ -169,23 +284,43 @@ void VocoderSynthesizer::process(const float* inL, const float* inR, float* outL
 
     const auto& envelope{ analyzer->getEnvelope() };
 
-    ::memcpy(tmpL.data(), inL, sizeof(float) * numFrames);
-    ::memcpy(tmpR.data(), inR, sizeof(float) * numFrames);
+    float* tmpL{ inputBuffer.getChannelData(0) };
+    float* tmpR{ inputBuffer.getChannelData(1) };
 
-    ::memset(outL, 0, sizeof(float) * numFrames);
-    ::memset(outR, 0, sizeof(float) * numFrames);
+    ::memcpy(tmpL, inL, sizeof(float) * numFrames);
+    ::memcpy(tmpR, inR, sizeof(float) * numFrames);
 
-    for (int i = 0; i < numFrames; ++i) {
-        for (int band = 0; band < vocoder::NUM_BANDS; ++band) {
-            const float l{ filterBankL.tick(band, tmpL[i]) };
-            const float r{ filterBankR.tick(band, tmpR[i]) };
+    auto* bands{ bandBuffer.data() };
+    auto* envelopes{ bands + numFrames };
+    auto* mixL{ mixBuffer.data() };
+    auto* mixR{ mixL + numFrames };
 
-            const float env{ envelope.getChannelData(band)[i] };
+    std::fill(mixL, mixL + 2 * numFrames, core::Float4::fill(0.0f));
 
-            outL[i] += l * env;
-            outR[i] += r * env;
-        }
+    // Bands are mixed by groups, then the lanes are summed up
+    for (size_t group = 0; group < vocoder::NUM_BAND_GROUPS; ++group) {
+        vocoder::loadBands(envelope, group, envelopes, numFrames);
+
+        filterBankL.process(group, tmpL, bands, numFrames);
+
+        for (int i = 0; i < numFrames; ++i)
+            mixL[i] = core::Float4::mulAdd(bands[i], envelopes[i], mixL[i]);
+
+        filterBankR.process(group, tmpR, bands, numFrames);
+
+        for (int i = 0; i < numFrames; ++i)
+            mixR[i] = core::Float4::mulAdd(bands[i], envelopes[i], mixR[i]);
     }
+
+    for (int i = 0; i < numFrames; ++i) {
+        outL[i] = mixL[i].sum();
+        outR[i] = mixR[i].sum();
+    }
+}
+
+int VocoderSynthesizer::getLinkedBus() const
+{
+    return (int)params[ANALYZER_BUS].getTargetValue();
 }
 
 } // namespace fx
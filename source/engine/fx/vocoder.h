@@ -10,10 +10,12 @@
 
 #include "../globals.h"
 #include "core/audio_buffer.h"
+#include "core/simd.h"
 #include "audio_effect.h"
 #include "dsp/filters.h"
 #include "dsp/hilbert.h"
 #include <array>
+#include <vector>
 
 TW_NAMESPACE_BEGIN
 
@@ -22,17 +24,38 @@ namespace fx {
 namespace vocoder {
 
 constexpr size_t NUM_BANDS = 32;
-
+constexpr size_t NUM_BAND_GROUPS = NUM_BANDS / 4;   ///< Bands are processed by four, in SIMD lanes.
+
+/**
+ * Band-pass filters bank.
+ *
+ * The coefficients and states of the bands are stored by groups
+ * of four, each group filtering its bands in the lanes of a vector.
+ */
 class FilterBank final
 {
 public:
     void update(float sampleRate);
     void reset();
-    float tick(int band, float in);
+
+    /**
+     * Filter a block through a group of bands.
+     * The output holds one vector per frame, with the group's bands in its lanes.
+     */
+    void process(size_t group, const float* in, core::Float4* out, int numFrames);
 
 protected:
-    std::array<dsp::BiquadFilter::Spec, NUM_BANDS> specs;
-    std::array<dsp::BiquadFilter::State, NUM_BANDS> states;
+
+    struct Group
+    {
+        core::Float4 b0, b1, b2;
+        core::Float4 a1, a2;
+
+        core::Float4 x[2];
+        core::Float4 y[2];
+    };
+
+    std::array<Group, NUM_BAND_GROUPS> groups;
 };
 
 } // namespace vocoder
@@ -57,8 +80,10 @@ public:
 private:
     vocoder::FilterBank filterBank;
     dsp::Hilbert::Spec hilbertSpec;
-    std::array<dsp::Hilbert::State, vocoder::NUM_BANDS> hilbertStates;
+    std::array<dsp::Hilbert::VectorState, vocoder::NUM_BAND_GROUPS> hilbertStates;
     core::AudioBuffer<float> envelope;
+    core::AudioBuffer<float> monoBuffer;
+    std::vector<core::Float4> bandBuffer;
 };
 
 //==============================================================================
@@ -84,6 +109,7 @@ public:
 
     void prepareToPlay() override;
     void process(const float* inL, const float* inR, float* outL, float* outR, int numFrames) override;
+    int getLinkedBus() const override;
 
 private:
 
@@ -92,8 +118,9 @@ private:
     vocoder::FilterBank filterBankL;
     vocoder::FilterBank filterBankR;
 
-    std::array<float, MIX_BUFFER_NUM_FRAMES> tmpL;
-    std::array<float, MIX_BUFFER_NUM_FRAMES> tmpR;
+    core::AudioBuffer<float> inputBuffer;
+    std::vector<core::Float4> bandBuffer;
+    std::vector<core::Float4> mixBuffer;
 };
 
 
@@ -10,6 +10,8 @@
 #include "voice.h"
 #include "sample.h"
 #include "audio_stream.h"
+#include "block_cache.h"
+#include "loop_cache.h"
 
 #include <cassert>
 
@@ -34,6 +36,9 @@ GlobalEngine::GlobalEngine()
     : voicePool{ std::make_unique<VoicePool>() }
     , samplePool{ std::make_unique<SamplePool>() }
     , audioStreamPool{ std::make_unique<AudioStreamPool>() }
+    , blockCache{ std::make_unique<BlockCache>() }
+    , loopCache{ std::make_unique<LoopCache>() }
+    , memoryArena{ std::make_shared<core::MemoryArena>() }
 {
     backgroundWorker.start();
 
@@ -91,6 +96,26 @@ AudioStreamPool& GlobalEngine::getAudioStreamPool()
     return *audioStreamPool;
 }
 
+BlockCache& GlobalEngine::getBlockCache()
+{
+    return *blockCache;
+}
+
+LoopCache& GlobalEngine::getLoopCache()
+{
+    return *loopCache;
+}
+
+const core::MemoryArena::Ptr& GlobalEngine::getMemoryArena() const noexcept
+{
+    return memoryArena;
+}
+
+void GlobalEngine::setBlockCacheSize(size_t numBytes)
+{
+    blockCache->setCapacity(numBytes);
+}
+
 core::Worker& GlobalEngine::getStreamWorker() noexcept
 {
     auto& worker{ streamWorkers[(size_t)nextWorkerIndex] };
@@ -10,6 +10,7 @@
 
 #include "globals.h"
 #include "core/list.h"
+#include "core/memory_arena.h"
 #include "core/release_pool.h"
 #include "core/worker.h"
 #include <memory>
@@ -20,6 +21,8 @@ TW_NAMESPACE_BEGIN
 class VoicePool;
 class SamplePool;
 class AudioStreamPool;
+class BlockCache;
+class LoopCache;
 
 /**
  * Engine global singleton.
@@ -76,6 +79,21 @@ public:
     VoicePool& getVoicePool();
     SamplePool& getSamplePool();
     AudioStreamPool& getAudioStreamPool();
+    BlockCache& getBlockCache();
+    LoopCache& getLoopCache();
+
+    /**
+     * Returns the memory arena shared by the effects' delay lines.
+     */
+    const core::MemoryArena::Ptr& getMemoryArena() const noexcept;
+
+    /**
+     * Set the memory budget (in bytes) of the decoded blocks cache
+     * shared by all the streams. Zero disables the cache.
+     *
+     * @note This will drop all the cached blocks.
+     */
+    void setBlockCacheSize(size_t numBytes);
 
     core::Worker& getStreamWorker() noexcept;
 
@@ -96,6 +114,9 @@ private:
     std::unique_ptr<VoicePool> voicePool;
     std::unique_ptr<SamplePool> samplePool;
     std::unique_ptr<AudioStreamPool> audioStreamPool;
+    std::unique_ptr<BlockCache> blockCache;
+    std::unique_ptr<LoopCache> loopCache;
+    core::MemoryArena::Ptr memoryArena;
 
     std::array<core::Worker, NUM_STREAM_WORKERS> streamWorkers;
     std::atomic<int> nextWorkerIndex{ 0 };
@@ -21,22 +21,36 @@ constexpr size_t DEFAULT_RELEASE_POOL_SIZE = 4096;
 constexpr float DEFAULT_SAMPLE_RATE_F = 44100.0f;
 
 constexpr int MIX_BUFFER_NUM_CHANNELS = 2;
-constexpr int MIX_BUFFER_NUM_FRAMES = 32;
+constexpr int MIX_BUFFER_NUM_FRAMES = 32;   ///< Default frame size until the engine is prepared.
+constexpr int MODULATION_BLOCK_SIZE = 32;   ///< Voice modulation update rate in frames.
 
 constexpr int DEFAULT_VOICE_POOL_SIZE = 256;
 constexpr int DEFAULT_AUDIO_STREAM_POOL_SIZE = 256;
+constexpr float VOICE_STEAL_RELEASE_TIME = 0.005f;  ///< Stolen voice fade-out time in seconds.
+constexpr int VOICE_STEAL_RESERVE = 8;              ///< Voices and streams kept for new notes while the stolen ones fade out.
 
 constexpr int MAX_PRELOAD_BUFFER_SIZE = 65536;
-constexpr int DEFAULT_STREAM_BUFFER_SIZE = 16384;
+constexpr int STREAM_BUFFER_CHUNK_SIZE = 4096;      ///< Stream buffers granularity in stereo frames.
+constexpr int MIN_STREAM_BUFFER_CHUNKS = 2;
+constexpr int MAX_STREAM_BUFFER_CHUNKS = 16;
+constexpr int DEFAULT_STREAM_BUFFER_POOL_SIZE = DEFAULT_AUDIO_STREAM_POOL_SIZE * 3;  ///< Number of chunks shared by the streams.
+constexpr float STREAM_BUFFER_MIN_DURATION = 0.1f;  ///< Min buffered playback time in seconds.
+constexpr float STREAM_REFILL_LATENCY_MARGIN = 8.0f; ///< Buffered time in units of the measured refill latency.
 constexpr int DEFAULT_XFADE_BUFFER_SIZE = 32;
 
+constexpr int CACHE_BLOCK_SIZE = 8192;
+constexpr size_t DEFAULT_BLOCK_CACHE_SIZE = 128 * 1024 * 1024;
+constexpr int DEFAULT_MAX_RESIDENT_LOOP_SIZE = 262144; ///< Longest loop kept in memory, in frames.
+
 constexpr int NUM_CC_PARAMETERS = 128;
 
 constexpr int NUM_STREAM_WORKERS = 4;
+constexpr int MAX_PRELOAD_WORKERS = 8;
 
 constexpr int NUM_BUSES = 16;
 constexpr int DEFAULT_TRIGGER_BUFFER_SIZE = 1024;
 constexpr int DEFAULT_RELEASE_BUFFER_SIZE = 1024;
+constexpr int DEFAULT_CC_BUFFER_SIZE = 1024;
 constexpr int DEFAULT_ACTUATOR_BUFFER_SUZE = 1024;
 
 TW_NAMESPACE_END
@@ -0,0 +1,60 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "loop_cache.h"
+#include <cassert>
+
+TW_NAMESPACE_BEGIN
+
+LoopCache::LoopPtr LoopCache::find(const Key& key)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (auto it{ loops.find(key) }; it != loops.end())
+        return it->second.lock();
+
+    return nullptr;
+}
+
+LoopCache::LoopPtr LoopCache::insert(const Key& key, LoopPtr loop)
+{
+    assert(loop != nullptr);
+
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    auto& entry{ loops[key] };
+
+    if (auto existing{ entry.lock() })
+        return existing;
+
+    entry = loop;
+
+    // Forget the loops that are no longer played
+    purge();
+
+    return loop;
+}
+
+size_t LoopCache::getNumLoops()
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    purge();
+    return loops.size();
+}
+
+void LoopCache::purge()
+{
+    for (auto it{ loops.begin() }; it != loops.end();) {
+        if (it->second.expired())
+            it = loops.erase(it);
+        else
+            ++it;
+    }
+}
+
+TW_NAMESPACE_END
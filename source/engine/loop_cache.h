@@ -0,0 +1,105 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "globals.h"
+#include "core/audio_buffer.h"
+#include "core/release_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+TW_NAMESPACE_BEGIN
+
+/**
+ * Registry of the decoded sample loops.
+ *
+ * Short loops are decoded once, with the loop cross-fade baked into
+ * their first frames, and shared by all the streams looping the same
+ * region of a sample. A loop is kept in memory for as long as a stream
+ * refers to it. The registry is accessed by the streaming threads only.
+ */
+class LoopCache final
+{
+public:
+
+    /**
+     * Decoded loop region.
+     */
+    struct Loop : public core::Releasable
+    {
+        Loop(int numChannels, int numFrames) : buffer{ numChannels, numFrames } {}
+
+        core::AudioBuffer<float> buffer;
+    };
+
+    using LoopPtr = std::shared_ptr<Loop>;
+
+    struct Key
+    {
+        std::size_t hash;   ///< Sample hash.
+        int begin;
+        int end;
+        int xfade;
+
+        bool operator ==(const Key& other) const noexcept
+        {
+            return hash == other.hash && begin == other.begin && end == other.end && xfade == other.xfade;
+        }
+    };
+
+    LoopCache() = default;
+    LoopCache(const LoopCache&) = delete;
+    LoopCache& operator =(const LoopCache&) = delete;
+
+    /**
+     * Set the longest loop (in frames) to be kept in memory.
+     * Zero disables the loops residency.
+     */
+    void setMaxLoopSize(int numFrames) noexcept { maxLoopSize = numFrames; }
+    int getMaxLoopSize() const noexcept { return maxLoopSize; }
+
+    bool isResidentSize(int numFrames) const noexcept { return numFrames > 0 && numFrames <= maxLoopSize; }
+
+    /**
+     * Look up a loop. Returns nullptr if it is not in memory.
+     */
+    LoopPtr find(const Key& key);
+
+    /**
+     * Register a decoded loop.
+     * If the loop has been registered concurrently, the existing one is returned.
+     */
+    LoopPtr insert(const Key& key, LoopPtr loop);
+
+    /**
+     * Returns the number of loops in memory.
+     */
+    size_t getNumLoops();
+
+private:
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const noexcept
+        {
+            return key.hash ^ ((std::size_t)key.begin * 0x9E3779B97F4A7C15ull) ^ ((std::size_t)key.end << 1);
+        }
+    };
+
+    void purge();
+
+    std::mutex mutex;
+    std::unordered_map<Key, std::weak_ptr<Loop>, KeyHash> loops;
+    std::atomic<int> maxLoopSize{ DEFAULT_MAX_RESIDENT_LOOP_SIZE };
+};
+
+TW_NAMESPACE_END
@@ -0,0 +1,318 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#include "preload_cache.h"
+#include "sample.h"
+#include "core/pcm.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TW_NAMESPACE_BEGIN
+
+namespace {
+
+constexpr char entryMagic[4]{ 'T', 'W', 'P', 'C' };
+constexpr uint32_t entryVersion{ 2 };
+constexpr uint32_t endOfSampleFlag{ 1 };
+
+/**
+ * Cache entry header, followed by the planar frames of each channel.
+ */
+struct EntryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t hash;
+    uint64_t fileSize;      ///< Source file size.
+    int64_t fileTime;       ///< Source file modification time.
+    int32_t startPos;
+    int32_t stopPos;
+    int32_t numFrames;
+    int32_t numChannels;    ///< Source file and stored channels.
+    float sampleRate;
+    uint32_t format;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(EntryHeader) == 64, "Cache entry header must keep the frames aligned");
+
+struct FileInfo
+{
+    uint64_t size{ 0 };
+    int64_t time{ 0 };
+};
+
+bool getFileInfo(const std::string& path, FileInfo& info)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code ec{};
+    const auto size{ fs::file_size(path, ec) };
+
+    if (ec)
+        return false;
+
+    const auto time{ fs::last_write_time(path, ec) };
+
+    if (ec)
+        return false;
+
+    info.size = (uint64_t)size;
+    info.time = (int64_t)time.time_since_epoch().count();
+
+    return true;
+}
+
+size_t getBytesPerSample(uint32_t format)
+{
+    return format == (uint32_t)PreloadCache::StorageFormat::Int16 ? sizeof(int16_t) : sizeof(float);
+}
+
+struct FileCloser
+{
+    void operator()(std::FILE* f) const { std::fclose(f); }
+};
+
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+} // anonymous namespace
+
+//==============================================================================
+
+core::Error PreloadCache::setDirectory(const std::string& path)
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (!path.empty()) {
+        std::error_code ec{};
+        std::filesystem::create_directories(path, ec);
+
+        if (ec || !std::filesystem::is_directory(path, ec)) {
+            directory.clear();
+            enabled = false;
+            return core::Error("Unable to create the preload cache directory " + path);
+        }
+    }
+
+    directory = path;
+    enabled = !directory.empty();
+    error = {};
+
+    return {};
+}
+
+std::string PreloadCache::getDirectory() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return directory;
+}
+
+bool PreloadCache::load(Sample& sample, int numFrames)
+{
+    if (!enabled)
+        return false;
+
+    const auto path{ getEntryPath(sample) };
+
+    if (path.empty() || numFrames <= 0)
+        return false;
+
+    FileInfo info{};
+    FilePtr file{ std::fopen(path.c_str(), "rb") };
+    EntryHeader header{};
+
+    if (file == nullptr
+        || !getFileInfo(sample.getAudioFile().getPath(), info)
+        || std::fread(&header, sizeof(header), 1, file.get()) != 1
+        || std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) != 0
+        || header.version != entryVersion
+        || header.hash != (uint64_t)sample.getHash()
+        || header.fileSize != info.size
+        || header.fileTime != info.time
+        || header.startPos != sample.getStartPosition()
+        || header.stopPos != sample.getStopPosition()
+        || header.numChannels < 1 || header.numChannels > 2
+        || header.format > (uint32_t)StorageFormat::Int16
+        || header.numFrames <= 0
+        || (header.numFrames < numFrames && (header.flags & endOfSampleFlag) == 0)) {
+        ++misses;
+        return false;
+    }
+
+    const int n{ std::min(numFrames, (int)header.numFrames) };
+    const size_t bytesPerSample{ getBytesPerSample(header.format) };
+
+    auto& buffer{ sample.preloadBuffer };
+    buffer.allocate(header.numChannels, n);
+
+    std::vector<int16_t> pcm{};
+
+    for (int ch = 0; ch < header.numChannels; ++ch) {
+        const long offset{ (long)(sizeof(header) + (size_t)ch * (size_t)header.numFrames * bytesPerSample) };
+        auto* dst{ buffer.getChannelData(ch) };
+        bool ok{ std::fseek(file.get(), offset, SEEK_SET) == 0 };
+
+        if (ok && header.format == (uint32_t)StorageFormat::Int16) {
+            pcm.resize((size_t)n);
+            ok = std::fread(pcm.data(), sizeof(int16_t), (size_t)n, file.get()) == (size_t)n;
+
+            if (ok)
+                core::pcm::convertS16((const uint8_t*)pcm.data(), 1, dst, nullptr, (size_t)n);
+        } else if (ok) {
+            ok = std::fread(dst, sizeof(float), (size_t)n, file.get()) == (size_t)n;
+        }
+
+        if (!ok) {
+            ++misses;
+            return false;
+        }
+    }
+
+    sample.getAudioFile().setProperties(header.sampleRate, header.numChannels);
+    sample.nPreloadedFrames = n;
+
+    ++hits;
+
+    return true;
+}
+
+core::Error PreloadCache::store(Sample& sample, bool endOfSample)
+{
+    auto res{ writeEntry(sample, endOfSample) };
+
+    if (res.failed()) {
+        // The next entries would most likely fail the same way
+        std::lock_guard<decltype(mutex)> lock(mutex);
+
+        if (enabled.exchange(false))
+            error = res;
+    }
+
+    return res;
+}
+
+core::Error PreloadCache::getError() const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    return error;
+}
+
+core::Error PreloadCache::writeEntry(Sample& sample, bool endOfSample)
+{
+    namespace fs = std::filesystem;
+
+    const auto path{ getEntryPath(sample) };
+    const int numFrames{ sample.getNumPreloadedFrames() };
+
+    if (path.empty() || numFrames <= 0)
+        return {};
+
+    FileInfo info{};
+
+    if (!getFileInfo(sample.getAudioFile().getPath(), info))
+        return core::Error("Unable to stat " + sample.getAudioFile().getPath());
+
+    const auto format{ storageFormat.load() };
+
+    EntryHeader header{};
+    std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.version = entryVersion;
+    header.hash = (uint64_t)sample.getHash();
+    header.fileSize = info.size;
+    header.fileTime = info.time;
+    header.startPos = sample.getStartPosition();
+    header.stopPos = sample.getStopPosition();
+    header.numFrames = numFrames;
+    header.numChannels = sample.getNumChannels();
+    header.sampleRate = sample.getAudioFile().getSampleRate();
+    header.format = (uint32_t)format;
+    header.flags = endOfSample ? endOfSampleFlag : 0;
+
+    // Write to a temporary file first, so that a concurrent reader
+    // never sees a partially written entry.
+    const auto tmpPath{ path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp" };
+
+    {
+        FilePtr file{ std::fopen(tmpPath.c_str(), "wb") };
+
+        if (file == nullptr)
+            return core::Error("Unable to write " + tmpPath);
+
+        bool ok{ std::fwrite(&header, sizeof(header), 1, file.get()) == 1 };
+        std::vector<int16_t> pcm{};
+
+        for (int ch = 0; ok && ch < header.numChannels; ++ch) {
+            const auto* src{ sample.getPreloadedSamples().getChannelData(ch) };
+
+            if (format == StorageFormat::Int16) {
+                pcm.resize((size_t)numFrames);
+
+                for (int i = 0; i < numFrames; ++i)
+                    pcm[(size_t)i] = (int16_t)std::clamp((int)std::lrint(src[i] * 32768.0f), -32768, 32767);
+
+                ok = std::fwrite(pcm.data(), sizeof(int16_t), pcm.size(), file.get()) == pcm.size();
+            } else {
+                ok = std::fwrite(src, sizeof(float), (size_t)numFrames, file.get()) == (size_t)numFrames;
+            }
+        }
+
+        if (!ok) {
+            file.reset();
+            std::error_code ec{};
+            fs::remove(tmpPath, ec);
+            return core::Error("Unable to write " + tmpPath);
+        }
+    }
+
+    std::error_code ec{};
+    fs::rename(tmpPath, path, ec);
+
+    if (ec) {
+        fs::remove(tmpPath, ec);
+        return core::Error("Unable to write " + path);
+    }
+
+    ++writes;
+
+    return {};
+}
+
+PreloadCache::Stats PreloadCache::getStats() const noexcept
+{
+    return { hits, misses, writes };
+}
+
+void PreloadCache::resetStats() noexcept
+{
+    hits = 0;
+    misses = 0;
+    writes = 0;
+}
+
+std::string PreloadCache::getEntryPath(const Sample& sample) const
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    if (directory.empty())
+        return {};
+
+    char name[32]{};
+    std::snprintf(name, sizeof(name), "%016llx.twpc", (unsigned long long)sample.getHash());
+
+    return (std::filesystem::path(directory) / name).string();
+}
+
+TW_NAMESPACE_END
@@ -0,0 +1,112 @@
+// *****************************************************************************
+//
+//  Tonewheel Audio Engine
+//
+//  Copyright (C) 2021 Arthur Benilov <arthur.benilov@gmail.com>
+//
+// *****************************************************************************
+
+#pragma once
+
+#include "globals.h"
+#include "core/error.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+TW_NAMESPACE_BEGIN
+
+class Sample;
+
+/**
+ * Persistent cache of the samples preload buffers.
+ *
+ * Each sample gets a file in the cache directory, named after the sample's
+ * hash and holding a fixed-size header followed by the planar preload
+ * frames (raw floats or 16-bit integers). An entry is only used if the
+ * source file size and modification time match the ones it was written
+ * with, so that compressed samples are decoded once and later loaded
+ * with a single read.
+ *
+ * The cache is disabled until a directory is set, and after
+ * an entry fails to be written.
+ */
+class PreloadCache final
+{
+public:
+
+    enum class StorageFormat
+    {
+        Float32,
+        Int16
+    };
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t writes;
+    };
+
+    PreloadCache() = default;
+    PreloadCache(const PreloadCache&) = delete;
+    PreloadCache& operator =(const PreloadCache&) = delete;
+
+    /**
+     * Set the cache directory, creating it if needed.
+     * An empty path disables the cache.
+     */
+    core::Error setDirectory(const std::string& path);
+    std::string getDirectory() const;
+    bool isEnabled() const noexcept { return enabled; }
+
+    /**
+     * Set the format of the new entries.
+     * 16-bit entries are half the size but lossy for non 16-bit sources.
+     */
+    void setStorageFormat(StorageFormat format) noexcept { storageFormat = format; }
+    StorageFormat getStorageFormat() const noexcept { return storageFormat; }
+
+    /**
+     * Load a sample's preload buffer from the cache.
+     *
+     * @returns false if there is no valid entry for this sample
+     *          holding at least the requested number of frames.
+     */
+    bool load(Sample& sample, int numFrames);
+
+    /**
+     * Write a sample's preload buffer to the cache.
+     * The cache gets disabled if the entry cannot be written.
+     *
+     * @param endOfSample Tells whether the preload buffer covers the whole sample.
+     */
+    core::Error store(Sample& sample, bool endOfSample);
+
+    /**
+     * Returns the error that disabled the cache,
+     * cleared when the directory is set.
+     */
+    core::Error getError() const;
+
+    Stats getStats() const noexcept;
+    void resetStats() noexcept;
+
+private:
+
+    std::string getEntryPath(const Sample& sample) const;
+    core::Error writeEntry(Sample& sample, bool endOfSample);
+
+    mutable std::mutex mutex;   ///< Guards the directory and the error.
+    std::string directory{};
+    core::Error error{};
+    std::atomic<bool> enabled{ false };
+    std::atomic<StorageFormat> storageFormat{ StorageFormat::Float32 };
+
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    std::atomic<uint64_t> writes{ 0 };
+};
+
+TW_NAMESPACE_END
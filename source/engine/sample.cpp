@@ -9,7 +9,11 @@
 #include "sample.h"
 #include "global_engine.h"
 #include "audio_stream.h"
+#include "block_cache.h"
+#include "core/mapped_file.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
 TW_NAMESPACE_BEGIN
 
@@ -17,6 +21,8 @@ Sample::Sample(AudioFile* audioFile, int start, int stop)
     : file(audioFile)
     , preloadBuffer(MIX_BUFFER_NUM_CHANNELS, MIX_BUFFER_NUM_FRAMES)
     , nPreloadedFrames{ 0 }
+    , preloadPass{ 0 }
+    , lastUsed{ 0 }
     , startPos{ std::max(0, start) }
     , stopPos{ stop }
     , hash{ calculateHash(file->getPath(), startPos, stopPos) }
@@ -33,8 +39,15 @@ Sample::Hash Sample::calculateHash(const std::string& filePath, int startPos, in
     return h;
 }
 
-core::Error Sample::preload(int numFrames)
+core::Error Sample::preload(int numFrames, PreloadCache* cache)
 {
+    int numFramesToPreload{ std::min(numFrames, MAX_PRELOAD_BUFFER_SIZE) };
+    if (stopPos > startPos)
+        numFramesToPreload = std::min(numFramesToPreload, stopPos - startPos);
+
+    if (cache != nullptr && cache->load(*this, numFramesToPreload))
+        return {};
+
     auto res{ file->open() };
 
     if (res.failed())
@@ -45,18 +58,23 @@ core::Error Sample::preload(int numFrames)
     if (res.failed())
         return res;
 
-    int numFramesToPreload{ std::min(numFrames, MAX_PRELOAD_BUFFER_SIZE) };
-    if (stopPos > startPos)
-        numFramesToPreload = std::min(numFramesToPreload, stopPos - startPos);
+    // Mono samples are kept mono
+    const int numChannels{ std::clamp(file->getNumChannels(), 1, MIX_BUFFER_NUM_CHANNELS) };
 
-    preloadBuffer.allocate(MIX_BUFFER_NUM_CHANNELS, (size_t)numFramesToPreload);
-    nPreloadedFrames = file->read(numFramesToPreload, preloadBuffer.getChannelData(0), preloadBuffer.getChannelData(1));
+    preloadBuffer.allocate(numChannels, numFramesToPreload);
+    nPreloadedFrames = file->read(numFramesToPreload, preloadBuffer.getChannelData(0),
+                                  numChannels > 1 ? preloadBuffer.getChannelData(1) : nullptr);
 
     file->close();
 
     if (nPreloadedFrames <= 0)
         return core::Error("Sample preload failed");
 
+    // A short read means the whole sample fits in the preload buffer.
+    // A failure disables the cache, which reports it.
+    if (cache != nullptr && cache->isEnabled())
+        cache->store(*this, nPreloadedFrames < numFramesToPreload);
+
     return {};
 }
 
@@ -64,11 +82,14 @@ core::Error Sample::preload(int numFrames)
 
 SamplePool::SamplePool()
 {
+    // Never reallocated, so that the audio thread can safely access the jobs
+    preloadJobs.reserve(MAX_PRELOAD_WORKERS);
 }
 
 SamplePool::~SamplePool()
 {
-    preloadWorker.stop();
+    for (auto& job : preloadJobs)
+        job->worker.stop();
 }
 
 Sample::Ptr SamplePool::addSample(const std::string& filePath, int startPos, int stopPos)
@@ -95,6 +116,12 @@ Sample::Ptr SamplePool::addSample(const std::string& filePath, int startPos, int
     hashToSampleMap[sampleHash] = sample;
     ++numSamples;
 
+    // Samples added while preloading join the current pass
+    if (preloading) {
+        preloadQueue.push_back(sample);
+        ++numPassSamples;
+    }
+
     return sample;
 }
 
@@ -103,8 +130,15 @@ void SamplePool::clear()
     std::lock_guard<decltype(mutex)> lock(mutex);
     hashToSampleMap.clear();
     samples.clear();
+    preloadQueue.clear();
+    preloadQueuePos = 0;
+    numPassSamples = 0;
     numPreloadedSamples = 0;
     numSamples = 0;
+
+    // Drop the decoded blocks and the files mappings that are no longer used
+    GlobalEngine::getInstance()->getBlockCache().clear();
+    core::MappedFile::purge();
 }
 
 Sample::Ptr SamplePool::getSampleByHash(std::size_t hash)
@@ -122,40 +156,152 @@ void SamplePool::preload(int numFrames)
     std::lock_guard<decltype(mutex)> lock(mutex);
 
     numPreloadFrames = numFrames;
+    ++preloadPass;
+
+    preloadQueue.clear();
+    preloadQueuePos = 0;
+
+    for (const auto& sample : samples) {
+        if (!sample->isPreloaded())
+            preloadQueue.push_back(sample);
+    }
+
+    // Most recently used samples first
+    std::stable_sort(preloadQueue.begin(), preloadQueue.end(),
+                     [](const Sample::Ptr& a, const Sample::Ptr& b) { return a->getLastUsed() > b->getLastUsed(); });
+
+    numPassSamples = (int)preloadQueue.size();
+    numPassPreloaded = 0;
+    numPassFailed = 0;
+    passStartTime = passEndTime = std::chrono::steady_clock::now();
 
-    if (!preloadWorker.isRunning())
-        preloadWorker.start();
+    if (preloadQueue.empty()) {
+        preloading = numActivePreloadJobs > 0;
+        return;
+    }
+
+    preloading = true;
+
+    if (preloadJobs.empty()) {
+        const int numWorkers{ std::clamp((int)std::thread::hardware_concurrency(), 1, MAX_PRELOAD_WORKERS) };
+
+        for (int i = 0; i < numWorkers; ++i) {
+            preloadJobs.push_back(std::make_unique<PreloadJob>(*this));
+            preloadJobs.back()->worker.start();
+        }
 
-    preloadWorker.addJob(this);
+        numPreloadWorkers = numWorkers;
+    }
+
+    const size_t numJobs{ std::min(preloadJobs.size(), preloadQueue.size()) };
+
+    for (size_t i = 0; i < numJobs; ++i)
+        preloadJobs[i]->worker.addJob(preloadJobs[i].get());
 }
 
-void SamplePool::run()
+void SamplePool::requestPreload(const Sample& sample) noexcept
 {
-    size_t idx = 0;
-
-    while (preloadWorker.isRunning()) {
-        std::unique_lock<decltype(mutex)> lock(mutex);
-        size_t total{ samples.size() };
-        int frames{ numPreloadFrames };
-
-        if (idx < total) {
-            auto sample{ samples[idx] };
-            lock.unlock();
-
-            if (!sample->isPreloaded()) {
-                auto res{ sample->preload(frames) };
-                if (res.ok()) {
-                    ++numPreloadedSamples;
-                } else {
-                    std::cerr << sample->getAudioFile().getPath() << ": " << res.message() << "\n";
-                }
-            }
-
-            ++idx;
-        } else {
+    const int numWorkers{ numPreloadWorkers };
+
+    if (sample.isPreloaded() || numWorkers == 0)
+        return;
+
+    if (preloadRequests.send(sample.getHash())) {
+        auto& job{ *preloadJobs[(size_t)sample.getHash() % (size_t)numWorkers] };
+        job.worker.addJob(&job);
+    }
+}
+
+void SamplePool::markUsed(Sample& sample) noexcept
+{
+    sample.lastUsed = ++usageCounter;
+}
+
+SamplePool::Status SamplePool::getStatus()
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+
+    Status status{};
+    status.preloadedSamples = numPreloadedSamples;
+    status.totalSamples = numSamples;
+    status.failedSamples = numPassFailed;
+    status.preloading = preloading;
+
+    const int numDone{ numPassPreloaded + numPassFailed };
+    const auto endTime{ preloading ? std::chrono::steady_clock::now() : passEndTime };
+
+    status.progress = numPassSamples > 0 ? std::min(1.0f, (float)numDone / (float)numPassSamples) : 1.0f;
+    status.elapsedTime = std::chrono::duration<double>(endTime - passStartTime).count();
+
+    if (!preloading)
+        status.remainingTime = 0.0;
+    else if (numDone > 0)
+        status.remainingTime = status.elapsedTime * (double)std::max(0, numPassSamples - numDone) / (double)numDone;
+    else
+        status.remainingTime = -1.0;
+
+    return status;
+}
+
+Sample::Ptr SamplePool::getNextSampleToPreload()
+{
+    Sample::Hash hash{};
+
+    while (preloadRequests.receive(hash)) {
+        if (auto it{ hashToSampleMap.find(hash) }; it != hashToSampleMap.end()) {
+            auto& sample{ it->second };
+
+            if (!sample->isPreloaded() && sample->claimPreload(preloadPass))
+                return sample;
+        }
+    }
+
+    while (preloadQueuePos < preloadQueue.size()) {
+        auto& sample{ preloadQueue[preloadQueuePos++] };
+
+        if (!sample->isPreloaded() && sample->claimPreload(preloadPass))
+            return sample;
+    }
+
+    return nullptr;
+}
+
+void SamplePool::preloadSamples(core::Worker& worker)
+{
+    std::unique_lock<decltype(mutex)> lock(mutex);
+    ++numActivePreloadJobs;
+
+    while (worker.isRunning()) {
+        auto sample{ getNextSampleToPreload() };
+
+        if (sample == nullptr)
             break;
+
+        const int frames{ numPreloadFrames };
+        lock.unlock();
+
+        auto res{ sample->preload(frames, &preloadCache) };
+
+        if (res.ok()) {
+            ++numPreloadedSamples;
+            ++numPassPreloaded;
+        } else {
+            ++numPassFailed;
+            std::cerr << sample->getAudioFile().getPath() << ": " << res.message() << "\n";
         }
+
+        lock.lock();
+    }
+
+    if (--numActivePreloadJobs == 0 && preloading) {
+        preloading = false;
+        passEndTime = std::chrono::steady_clock::now();
     }
 }
 
+void SamplePool::PreloadJob::run()
+{
+    samplePool.preloadSamples(worker);
+}
+
 TW_NAMESPACE_END
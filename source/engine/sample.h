@@ -10,12 +10,16 @@
 
 #include "globals.h"
 #include "audio_file.h"
+#include "preload_cache.h"
 #include "core/audio_buffer.h"
 #include "core/error.h"
+#include "core/mpmc_queue.h"
 #include "core/worker.h"
 #include "core/release_pool.h"
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <mutex>
 #include <unordered_map>
@@ -25,6 +29,7 @@
 TW_NAMESPACE_BEGIN
 
 class AudioStream;
+class PreloadCache;
 
 /**
  * This class represents a single sample.
@@ -61,20 +66,52 @@ public:
     AudioFile& getAudioFile() { return *file; }
     const core::AudioBuffer<float>& getPreloadedSamples() const noexcept { return preloadBuffer; }
 
-    core::Error preload(int numFrames);
+    /**
+     * Preload the sample's first frames.
+     * If a cache is given, the frames are loaded from it when possible,
+     * otherwise they are decoded and written to the cache.
+     */
+    core::Error preload(int numFrames, PreloadCache* cache = nullptr);
 
     bool isPreloaded() const noexcept { return nPreloadedFrames > 0; }
+
+    /**
+     * Returns the number of channels the sample is stored with (1 or 2),
+     * which is known once the sample is preloaded.
+     */
+    int getNumChannels() const noexcept { return preloadBuffer.getNumChannels(); }
+
     int getNumPreloadedFrames() const noexcept { return nPreloadedFrames; }
     int getStartPosition() const noexcept { return startPos; }
     int getStopPosition() const noexcept { return stopPos; }
 
+    /**
+     * Returns the last time (as the pool's usage counter) this sample
+     * has been triggered, zero if it has never been used.
+     */
+    uint64_t getLastUsed() const noexcept { return lastUsed; }
+
 private:
+
+    /**
+     * Claim the sample for a preload pass, so that it is
+     * preloaded by a single thread.
+     *
+     * @returns false if the sample has already been claimed for this pass.
+     */
+    bool claimPreload(int pass) noexcept { return preloadPass.exchange(pass) != pass; }
+
     std::unique_ptr<AudioFile> file;
     core::AudioBuffer<float> preloadBuffer;
     std::atomic<int> nPreloadedFrames;
+    std::atomic<int> preloadPass;
+    std::atomic<uint64_t> lastUsed;
     int startPos;
     int stopPos;
     Hash hash;
+
+    friend class SamplePool;
+    friend class PreloadCache;
 };
 
 //==============================================================================
@@ -86,9 +123,14 @@ private:
  * be normally just one instance of the samples pool which
  * lives in the GlobalEngine singleton.
  *
+ * Samples are preloaded in parallel by a set of workers sized
+ * to the machine. The most recently used samples are preloaded first,
+ * and the samples requested by the audio thread (e.g. triggered
+ * while not preloaded yet) jump the queue.
+ *
  * @see GlobalEngine.
  */
-class SamplePool final : public core::Worker::Job
+class SamplePool final
 {
 public:
 
@@ -96,6 +138,11 @@ public:
     {
         int preloadedSamples;
         int totalSamples;
+        int failedSamples;      ///< Samples that failed to preload in the current pass.
+        bool preloading;
+        float progress;         ///< Current preload pass progress, from 0 to 1.
+        double elapsedTime;     ///< Current (or last) preload pass duration in seconds.
+        double remainingTime;   ///< Estimated time to complete the preload in seconds, negative if unknown.
     };
 
     SamplePool();
@@ -122,22 +169,95 @@ public:
      */
     Sample::Ptr getSampleByHash(std::size_t hash);
 
+    /**
+     * Preload all the samples that are not preloaded yet.
+     * This returns immediately, the samples are preloaded in the background.
+     */
     void preload(int numFrames);
 
-    // Worker::Job
-    void run() override;
+    /**
+     * Tells whether the samples are being preloaded.
+     */
+    bool isPreloading() const noexcept { return preloading; }
+
+    /**
+     * Ask for a sample to be preloaded ahead of the others.
+     *
+     * @note This is lock-free and can be called from the audio thread.
+     */
+    void requestPreload(const Sample& sample) noexcept;
+
+    /**
+     * Mark a sample as used, so that it gets preloaded first
+     * on the next preload pass.
+     *
+     * @note This is lock-free and can be called from the audio thread.
+     */
+    void markUsed(Sample& sample) noexcept;
+
+    /**
+     * Returns the preload progress.
+     */
+    Status getStatus();
+
+    int getNumPreloadWorkers() const noexcept { return numPreloadWorkers; }
+
+    /**
+     * Persistent cache of the preload buffers, disabled by default.
+     */
+    PreloadCache& getPreloadCache() noexcept { return preloadCache; }
 
 private:
+
+    /**
+     * Preload job, one per worker.
+     */
+    class PreloadJob final : public core::Worker::Job
+    {
+    public:
+        explicit PreloadJob(SamplePool& pool) : samplePool{ pool } {}
+        void run() override;
+
+        core::Worker worker;
+
+    private:
+        SamplePool& samplePool;
+    };
+
+    void preloadSamples(core::Worker& worker);
+
+    /**
+     * Returns the next sample to be preloaded, or nullptr if there is none.
+     */
+    Sample::Ptr getNextSampleToPreload();
+
     std::vector<Sample::Ptr> samples;
     std::unordered_map<std::size_t, Sample::Ptr> hashToSampleMap;
 
+    PreloadCache preloadCache;
+
     std::atomic<int> numPreloadedSamples;
     std::atomic<int> numSamples;
 
     std::mutex mutex;
 
-    core::Worker preloadWorker;
-    std::atomic<int> numPreloadFrames;
+    std::vector<std::unique_ptr<PreloadJob>> preloadJobs;
+    std::atomic<int> numPreloadWorkers{ 0 };
+    core::MPMCQueue<Sample::Hash, 1024> preloadRequests;    ///< Samples to be preloaded first.
+    std::vector<Sample::Ptr> preloadQueue;                  ///< Samples to preload in the current pass.
+    size_t preloadQueuePos{ 0 };
+    int preloadPass{ 0 };
+    int numPreloadFrames{ 0 };
+
+    int numActivePreloadJobs{ 0 };
+    std::atomic<int> numPassPreloaded{ 0 };
+    std::atomic<int> numPassFailed{ 0 };
+    int numPassSamples{ 0 };
+    std::chrono::steady_clock::time_point passStartTime{};
+    std::chrono::steady_clock::time_point passEndTime{};
+
+    std::atomic<uint64_t> usageCounter{ 0 };
+    std::atomic<bool> preloading{ false };
 };
 
 TW_NAMESPACE_END
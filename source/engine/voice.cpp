@@ -10,10 +10,17 @@
 #include "global_engine.h"
 #include "engine.h"
 #include "core/math.h"
+#include <bit>
 #include <cassert>
 
 TW_NAMESPACE_BEGIN
 
+namespace {
+
+constexpr int gainBlockSize{ 64 };  ///< Frames of envelope and gain computed at once.
+
+} // anonymous namespace
+
 Voice::Modulator::Modulator()
     : GenericModulator(NUM_MODS)
 {
@@ -28,7 +35,11 @@ Voice::Modulator::Modulator()
 //==============================================================================
 
 Voice::Voice()
-    : params(NUM_PARAMS)
+    : sourceBuffer(MIX_BUFFER_NUM_CHANNELS, dsp::Resampler::sourceBufferSize)
+    , accFrac{ 0.0f }
+    , params(NUM_PARAMS)
+    , fxTailCountdown{ 0 }
+    , stolen{ false }
 {
     params[GAIN].setName("gain");
     params[GAIN].setRange(0.0f, 16.0f); // Allow +24dB gain
@@ -66,12 +77,28 @@ void Voice::resetAndReturnToPool()
 }
 
 void Voice::process(float* outL, float* outR, int numFrames)
+{
+    if (voiceTrigger.modulator == nullptr) {
+        processBlock(outL, outR, numFrames);
+        return;
+    }
+
+    // Keep the modulation rate independent of the host block size
+    for (int offset = 0; offset < numFrames; offset += MODULATION_BLOCK_SIZE) {
+        const int n{ std::min(MODULATION_BLOCK_SIZE, numFrames - offset) };
+        processBlock(&outL[offset], &outR[offset], n);
+    }
+}
+
+void Voice::processBlock(float* outL, float* outR, int numFrames)
 {
     assert(voiceTrigger.stream != nullptr);
 
     // Run modulation
     modulateOnProcess();
 
+    voiceTrigger.stream->setPlaybackRate(speed * params[PITCH].getCurrentValue() * engine->getSampleRate());
+
     // Process the FX tail only
     if (envelope.getState() == dsp::Envelope::State::Off && fxTailCountdown > 0) {
         int framesThisTime{ std::min(numFrames, fxTailCountdown) };
@@ -83,28 +110,10 @@ void Voice::process(float* outL, float* outR, int numFrames)
         return;
     }
 
-    int generatedFrames{ 0 };
+    // Mono samples are rendered on the left channel only and then copied to the right one
+    const bool mono{ voiceTrigger.stream->getNumChannels() == 1 };
 
-    bool streamIsActive{ true };
-
-    while (streamIsActive && generatedFrames < numFrames) {
-        const float dFrac{ speed * params[PITCH].getNextValue() };
-        accFrac += dFrac;
-
-        while (accFrac >= 1.0f) {
-            streamIsActive = voiceTrigger.stream->readOne(accL[accIndex], accR[accIndex]);
-
-            accL[accIndex + 4] = accL[accIndex];
-            accR[accIndex + 4] = accR[accIndex];
-            accIndex = (accIndex + 1) % 4;
-            accFrac -= 1.0f;
-        }
-
-        outL[generatedFrames] = core::math::lagr(&accL[accIndex], accFrac);
-        outR[generatedFrames] = core::math::lagr(&accR[accIndex], accFrac);
-
-        ++generatedFrames;
-    }
+    const int generatedFrames{ resample(outL, mono ? nullptr : outR, numFrames) };
 
     if (generatedFrames < numFrames)
     {
@@ -112,7 +121,9 @@ void Voice::process(float* outL, float* outR, int numFrames)
         const auto residual = numFrames - generatedFrames;
 
         ::memset(&outL[generatedFrames], 0, sizeof(float) * residual);
-        ::memset(&outR[generatedFrames], 0, sizeof(float) * residual);
+
+        if (!mono)
+            ::memset(&outR[generatedFrames], 0, sizeof(float) * residual);
 
         // If the stream has been depleted we release the voice here.
         if (voiceTrigger.stream->isOver())
@@ -120,18 +131,33 @@ void Voice::process(float* outL, float* outR, int numFrames)
     }
 
     // Apply voice envelope and gain
-    for (size_t i = 0; i < numFrames; ++i)
-    {
-        const auto env = envelope.getNext() * voiceTrigger.gain * params[GAIN].getNextValue();
+    for (int offset = 0; offset < numFrames; offset += gainBlockSize) {
+        const int n{ std::min(gainBlockSize, numFrames - offset) };
+
+        float env[gainBlockSize];
+        float gain[gainBlockSize];
+        envelope.process(env, n);
+        params[GAIN].getValues(gain, n);
 
-        outL[i] *= env;
-        outR[i] *= env;
+        for (int i = 0; i < n; ++i)
+            env[i] *= voiceTrigger.gain * gain[i];
+
+        for (int i = 0; i < n; ++i)
+            outL[offset + i] *= env[i];
+
+        if (!mono) {
+            for (int i = 0; i < n; ++i)
+                outR[offset + i] *= env[i];
+        }
     }
 
+    if (mono)
+        ::memcpy(outR, outL, sizeof(float) * numFrames);
+
     if (envelope.getState() == dsp::Envelope::State::Off) {
         voiceTrigger.stream->release();
 
-        fxTailCountdown = { voiceTrigger.fxChain == nullptr ? 0 : voiceTrigger.fxChain->getTailLength() };
+        fxTailCountdown = { voiceTrigger.fxChain == nullptr || stolen ? 0 : voiceTrigger.fxChain->getTailLength() };
     }
 
     if (voiceTrigger.fxChain != nullptr) {
@@ -141,52 +167,130 @@ void Voice::process(float* outL, float* outR, int numFrames)
     samplePos += numFrames;
 }
 
-/*
-void Voice::processOne(float& left, float& right)
+int Voice::resample(float* outL, float* outR, int numFrames)
 {
-    assert(voiceTrigger.stream != nullptr);
+    constexpr int H{ dsp::Resampler::historySize };
 
-    const float dFrac = speed * params[PITCH].getNextValue();
-    accFrac += dFrac;
+    auto* stream{ voiceTrigger.stream };
 
-    while (accFrac >= 1.0f) {
-        voiceTrigger.stream->readOne(accL[accIndex], accR[accIndex]);
+    float* srcL{ sourceBuffer.getChannelData(0) };
+    float* srcR{ sourceBuffer.getChannelData(1) };
 
-        accL[accIndex + 4] = accL[accIndex];
-        accR[accIndex + 4] = accR[accIndex];
-        accIndex = (accIndex + 1) % 4;
-        accFrac -= 1.0f;
-    }
+    int index[dsp::Resampler::maxBlockSize];
+    float frac[dsp::Resampler::maxBlockSize];
+    float rates[dsp::Resampler::maxBlockSize];
+
+    int generatedFrames{ 0 };
+
+    while (generatedFrames < numFrames) {
+        const int blockSize{ std::min(numFrames - generatedFrames, dsp::Resampler::maxBlockSize) };
+        float* blockL{ &outL[generatedFrames] };
+        float* blockR{ outR != nullptr ? &outR[generatedFrames] : nullptr };
+
+        int framesRead{ 0 };
+        int framesDone{ 0 };
+
+        if (!params[PITCH].isSmoothing() && speed * params[PITCH].getCurrentValue() == 1.0f) {
+            // Unity playback rate: each output frame consumes exactly one source frame,
+            // so the interpolation reduces to a copy or a fixed 4-tap filter.
+            framesRead = stream->fillBuffers(&srcL[H], &srcR[H], blockSize);
+            framesDone = framesRead;
+
+            dsp::Resampler::interpolate(&srcL[1], accFrac, blockL, framesDone);
+
+            if (blockR != nullptr)
+                dsp::Resampler::interpolate(&srcR[1], accFrac, blockR, framesDone);
+        } else {
+            params[PITCH].getValues(rates, blockSize);
+
+            for (int i = 0; i < blockSize; ++i)
+                rates[i] *= speed;
+
+            float acc{ accFrac };
+            const int framesNeeded{ dsp::Resampler::computePositions(acc, rates, index, frac, blockSize) };
+            framesRead = framesNeeded > 0 ? stream->fillBuffers(&srcL[H], &srcR[H], framesNeeded) : 0;
+            framesDone = blockSize;
+
+            if (framesRead < framesNeeded) {
+                // Only generate the frames the stream could deliver the source for
+                framesDone = 0;
+
+                while (framesDone < blockSize && index[framesDone] <= framesRead)
+                    ++framesDone;
+
+                acc = framesDone > 0 ? frac[framesDone - 1] : accFrac;
+            }
+
+            accFrac = acc;
+
+            dsp::Resampler::interpolate(srcL, index, frac, blockL, framesDone);
+
+            if (blockR != nullptr)
+                dsp::Resampler::interpolate(srcR, index, frac, blockR, framesDone);
+        }
 
-    left  = core::math::lagr(&accL[accIndex], accFrac);
-    right = core::math::lagr(&accR[accIndex], accFrac);
+        // Keep the most recent source frames as the history for the next block
+        ::memmove(srcL, &srcL[framesRead], sizeof(float) * H);
 
-    ++samplePos;
+        if (outR != nullptr)
+            ::memmove(srcR, &srcR[framesRead], sizeof(float) * H);
+
+        generatedFrames += framesDone;
+
+        if (framesDone < blockSize)
+            break;
+    }
+
+    return generatedFrames;
 }
-*/
 
 void Voice::release()
 {
+    if (stolen)
+        return;
+
     envelope.release();
 }
 
 void Voice::releaseWithReleaseTime(float t)
 {
+    if (stolen)
+        return;
+
     envelope.release(t);
 
     modulateOnRelease();
 }
 
+void Voice::steal()
+{
+    if (envelope.getState() != dsp::Envelope::State::Off)
+        envelope.release(VOICE_STEAL_RELEASE_TIME);
+
+    fxTailCountdown = 0;
+    stolen = true;
+}
+
+bool Voice::isReleased() const noexcept
+{
+    const auto state{ envelope.getState() };
+    return state == dsp::Envelope::State::Release || state == dsp::Envelope::State::Off;
+}
+
+float Voice::getLevel() const noexcept
+{
+    return envelope.getLevel() * voiceTrigger.gain * params[GAIN].getCurrentValue();
+}
+
 void Voice::trigger(Engine* eng, const Voice::Trigger& trig)
 {
     assert(eng != nullptr);
     engine = eng;
     voiceTrigger = trig;
 
-    ::memset(accL, 0, sizeof (float) * 8);
-    ::memset(accR, 0, sizeof (float) * 8);
-    accIndex = 0;
+    sourceBuffer.clear();
     accFrac = 0.0f;
+    stolen = false;
 
     // Adjust playback sample rate vs stream sample rate
     srAdjust = (float)voiceTrigger.stream->getSampleRate() / engine->getSampleRate();
@@ -207,6 +311,7 @@ void Voice::reset()
 {
     samplePos = 0;
     fxTailCountdown = 0;
+    stolen = false;
     params[GAIN].setValue(1.0f, true);
     params[PITCH].setValue(1.0f, true);
 
@@ -298,4 +403,109 @@ void VoicePool::returnToPool(Voice* voice)
     --activeVoicesCount;
 }
 
+//==============================================================================
+
+VoiceIndex::VoiceIndex(int maxVoices)
+    : slots(std::bit_ceil((size_t)std::max(1, maxVoices) * 2), nullptr)
+    , mask{ slots.size() - 1 }
+    , numVoices{ 0 }
+{
+}
+
+void VoiceIndex::add(Voice* voice)
+{
+    assert(voice != nullptr);
+    assert(numVoices < (int)mask);
+
+    size_t i{ slotFor(voice->getTrigger().voiceId) };
+
+    while (slots[i] != nullptr)
+        i = (i + 1) & mask;
+
+    slots[i] = voice;
+    ++numVoices;
+
+    const int key{ voice->getTrigger().key };
+
+    if (key >= 0 && key < numKeys)
+        keyLists[(size_t)key].append(voice);
+}
+
+void VoiceIndex::remove(Voice* voice)
+{
+    assert(voice != nullptr);
+
+    size_t i{ slotFor(voice->getTrigger().voiceId) };
+
+    while (slots[i] != nullptr && slots[i] != voice)
+        i = (i + 1) & mask;
+
+    if (slots[i] == nullptr)
+        return;
+
+    // Shift back the following entries that would become unreachable
+    size_t j{ i };
+
+    for (;;) {
+        j = (j + 1) & mask;
+
+        if (slots[j] == nullptr)
+            break;
+
+        const size_t home{ slotFor(slots[j]->getTrigger().voiceId) };
+        const bool reachable{ i <= j ? (i < home && home <= j) : (i < home || home <= j) };
+
+        if (!reachable) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i] = nullptr;
+    --numVoices;
+
+    const int key{ voice->getTrigger().key };
+
+    if (key >= 0 && key < numKeys)
+        keyLists[(size_t)key].remove(voice);
+}
+
+void VoiceIndex::clear()
+{
+    for (auto*& voice : slots) {
+        if (voice != nullptr) {
+            const int key{ voice->getTrigger().key };
+
+            if (key >= 0 && key < numKeys)
+                keyLists[(size_t)key].remove(voice);
+
+            voice = nullptr;
+        }
+    }
+
+    numVoices = 0;
+}
+
+Voice* VoiceIndex::findVoiceWithId(int voiceId) const noexcept
+{
+    size_t i{ slotFor(voiceId) };
+
+    while (slots[i] != nullptr) {
+        if (slots[i]->getTrigger().voiceId == voiceId)
+            return slots[i];
+
+        i = (i + 1) & mask;
+    }
+
+    return nullptr;
+}
+
+VoiceIndex::KeyList& VoiceIndex::getVoicesForKey(int key)
+{
+    if (key >= 0 && key < numKeys)
+        return keyLists[(size_t)key];
+
+    return emptyList;
+}
+
 TW_NAMESPACE_END
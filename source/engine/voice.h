@@ -15,19 +15,43 @@
 #include "modulation.h"
 #include "core/list.h"
 #include "dsp/envelope.h"
+#include "dsp/resampler.h"
+#include "core/audio_buffer.h"
+#include <array>
 #include <atomic>
+#include <vector>
 
 TW_NAMESPACE_BEGIN
 
 class Engine;
 
+/**
+ * Policy used to choose a voice to be stolen.
+ */
+enum class VoiceStealing
+{
+    Oldest,         ///< Steal the oldest voice.
+    Quietest,       ///< Steal the voice with the lowest level.
+    SameKey,        ///< Steal the oldest voice playing the same key, or the oldest one.
+    ReleasedFirst   ///< Steal the oldest released voice, or the oldest one.
+};
+
+/**
+ * Tag of the voices lists grouped by key.
+ */
+struct VoiceKeyListTag {};
+
 /**
  * This class represents a single playing voice.
  */
-class Voice : public core::ListItem<Voice>
+class Voice : public core::ListItem<Voice>,
+              public core::ListItem<Voice, VoiceKeyListTag>
 {
 public:
 
+    using core::ListItem<Voice>::next;
+    using core::ListItem<Voice>::prev;
+
     class Modulator : public GenericModulator
     {
     public:
@@ -82,16 +106,49 @@ public:
     void release();
     void releaseWithReleaseTime(float t);
 
+    /**
+     * Fade the voice out quickly to make room for another one.
+     * A stolen voice ignores further releases.
+     */
+    void steal();
+    bool isStolen() const noexcept { return stolen; }
+
+    bool isReleased() const noexcept;
+
+    /**
+     * Returns the current voice output level (envelope and gain).
+     */
+    float getLevel() const noexcept;
+
     void trigger(Engine* eng, const Voice::Trigger& trig);
 
     const Trigger& getTrigger() const noexcept { return voiceTrigger; }
 
     bool isForKey(int key) const noexcept { return voiceTrigger.key == key; }
 
+    /**
+     * Returns the next voice playing the same key (see VoiceIndex).
+     */
+    Voice* nextForKey() noexcept { return core::ListItem<Voice, VoiceKeyListTag>::next(); }
+
 private:
 
     void reset();
 
+    /**
+     * Render a block of at most MODULATION_BLOCK_SIZE frames
+     * when the voice has a modulator.
+     */
+    void processBlock(float* outL, float* outR, int numFrames);
+
+    /**
+     * Read from the stream and resample into the output buffers.
+     * Returns the number of frames generated, which can be less than
+     * requested if the stream is depleted or underruns.
+     * For mono streams outR is nullptr.
+     */
+    int resample(float* outL, float* outR, int numFrames);
+
     void modulateOnTrigger();
     void modulateOnProcess();
     void modulateOnRelease();
@@ -102,10 +159,8 @@ private:
     float srAdjust; ///< Sample rate adjustment.
     float speed;    ///< Playback speed.
 
-    float accL[8];
-    float accR[8];
-    int accIndex;
-    float accFrac;
+    core::AudioBuffer<float> sourceBuffer;  ///< Resampler history followed by the frames read from the stream.
+    float accFrac;                          ///< Fractional read position.
 
     dsp::Envelope envelope;
 
@@ -114,6 +169,8 @@ private:
     int samplePos;
 
     int fxTailCountdown;
+
+    bool stolen;
 };
 
 //==============================================================================
@@ -127,7 +184,10 @@ public:
     Voice* getVoice();
     void returnToPool(Voice* voice);
 
+    int getSize() const noexcept { return (int)voices.size(); }
     int getNumActiveVoices() const noexcept { return activeVoicesCount.load(); }
+    bool hasIdleVoices() const noexcept { return !idleVoices.isEmpty(); }
+    int getNumIdleVoices() const noexcept { return getSize() - activeVoicesCount.load(); }
 
 private:
     std::vector<Voice> voices;
@@ -135,4 +195,50 @@ private:
     std::atomic<int> activeVoicesCount;
 };
 
+//==============================================================================
+
+/**
+ * Index of the active voices by their ID and by their MIDI key.
+ *
+ * The voices are hashed by ID into an open-addressing table large enough
+ * to hold all the voices of the pool, so the lookup is constant-time.
+ * Voices are also linked into per-key lists.
+ *
+ * @note The index is owned by the audio thread.
+ */
+class VoiceIndex final
+{
+public:
+
+    using KeyList = core::List<Voice, VoiceKeyListTag>;
+
+    constexpr static int numKeys{ 128 };
+
+    VoiceIndex(int maxVoices = DEFAULT_VOICE_POOL_SIZE);
+
+    void add(Voice* voice);
+    void remove(Voice* voice);
+    void clear();
+
+    Voice* findVoiceWithId(int voiceId) const noexcept;
+
+    /**
+     * Returns the voices playing a key, in the triggering order.
+     * Voices with a key outside of the MIDI range are not listed.
+     */
+    KeyList& getVoicesForKey(int key);
+
+    int getNumVoices() const noexcept { return numVoices; }
+
+private:
+
+    size_t slotFor(int voiceId) const noexcept { return (size_t)voiceId & mask; }
+
+    std::vector<Voice*> slots;
+    size_t mask;
+    int numVoices;
+    std::array<KeyList, numKeys> keyLists;
+    KeyList emptyList;
+};
+
 TW_NAMESPACE_END
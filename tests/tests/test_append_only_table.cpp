@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "engine/core/append_only_table.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace tonewheel;
+
+TEST(core, AppendOnlyTable)
+{
+    core::AppendOnlyTable<int, 4, 4> table;
+
+    EXPECT_EQ(table.size(), 0);
+    EXPECT_EQ(table.get(0), nullptr);
+
+    for (int i = 0; i < 16; ++i)
+        EXPECT_EQ(table.append(i * 10), i);
+
+    // Table is full
+    EXPECT_EQ(table.append(160), -1);
+    EXPECT_EQ(table.size(), 16);
+
+    for (int i = 0; i < 16; ++i) {
+        ASSERT_NE(table.get(i), nullptr);
+        EXPECT_EQ(*table.get(i), i * 10);
+    }
+
+    EXPECT_EQ(table.get(-1), nullptr);
+    EXPECT_EQ(table.get(16), nullptr);
+
+    // Concurrent reader sees only fully published items
+    core::AppendOnlyTable<int, 64> shared;
+    constexpr int numItems{ 10000 };
+    std::atomic<bool> failed{ false };
+
+    std::thread reader([&]() {
+        while (shared.size() < numItems) {
+            const int n{ shared.size() };
+
+            for (int i = std::max(0, n - 8); i < n; ++i) {
+                const int* item{ shared.get(i) };
+
+                if (item == nullptr || *item != i)
+                    failed = true;
+            }
+        }
+    });
+
+    for (int i = 0; i < numItems; ++i)
+        shared.append(i);
+
+    reader.join();
+    EXPECT_FALSE(failed);
+}
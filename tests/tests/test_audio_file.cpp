@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+#include "engine/audio_file.h"
+#include <cstdint>
+#include <vector>
+
+using namespace tonewheel;
+
+namespace {
+
+/** Write a 48kHz WAV file with a chunk to be skipped before the data. */
+std::string writeWav(const std::string& name, uint16_t format, int channels, int bitsPerSample,
+                     int numFrames, const test::WavGenerator& generator)
+{
+    test::WavFormat fmt{};
+    fmt.format = format;
+    fmt.numChannels = channels;
+    fmt.bitsPerSample = bitsPerSample;
+    fmt.sampleRate = 48000;
+    fmt.junkChunk = true;
+
+    return test::writeWav(name, fmt, numFrames, generator);
+}
+
+} // anonymous namespace
+
+TEST(core, AudioFileWav)
+{
+    constexpr int numFrames{ 37 };
+
+    // 16-bit stereo
+    {
+        const auto generator = [](auto& payload, int i, int ch) {
+            test::put16(payload, uint16_t(int16_t(ch == 0 ? i * 512 - 9000 : -i * 256)));
+        };
+
+        AudioFile file(writeWav("tw_test_s16.wav", 0x01, 2, 16, numFrames, generator), AudioFile::Format::WavPCM);
+        ASSERT_TRUE(file.open().ok());
+        EXPECT_EQ(file.getNumChannels(), 2);
+        EXPECT_EQ(file.getSampleRate(), 48000.0f);
+        ASSERT_TRUE(file.seek(5).ok());
+
+        float left[numFrames];
+        float right[numFrames];
+        const int n{ file.read(numFrames, left, right) };
+        ASSERT_EQ(n, numFrames - 5);
+
+        for (int i = 0; i < n; ++i) {
+            EXPECT_FLOAT_EQ(left[i], float((i + 5) * 512 - 9000) / 32768.0f);
+            EXPECT_FLOAT_EQ(right[i], float(-(i + 5) * 256) / 32768.0f);
+        }
+    }
+
+    // 24-bit mono
+    {
+        const auto generator = [](auto& payload, int i, int) {
+            test::put24(payload, uint32_t(i * 100000 - 2000000));
+        };
+
+        AudioFile file(writeWav("tw_test_s24.wav", 0x01, 1, 24, numFrames, generator), AudioFile::Format::WavPCM);
+        ASSERT_TRUE(file.open().ok());
+
+        // Mono files only fill the left channel
+        float left[numFrames];
+        ASSERT_EQ(file.read(numFrames, left, nullptr), numFrames);
+        EXPECT_EQ(file.getNumChannels(), 1);
+
+        for (int i = 0; i < numFrames; ++i)
+            EXPECT_FLOAT_EQ(left[i], float(i * 100000 - 2000000) / 8388608.0f);
+    }
+
+    // 32-bit float stereo
+    {
+        std::vector<float> samples{};
+
+        for (int i = 0; i < 2 * numFrames; ++i)
+            samples.push_back(0.01f * float(i) - 0.3f);
+
+        const auto generator = [&samples](auto& payload, int i, int ch) {
+            test::putFloat(payload, samples[(size_t)(2 * i + ch)]);
+        };
+
+        AudioFile file(writeWav("tw_test_f32.wav", 0x03, 2, 32, numFrames, generator), AudioFile::Format::WavPCM);
+        ASSERT_TRUE(file.open().ok());
+
+        float left[numFrames];
+        float right[numFrames];
+        ASSERT_EQ(file.read(numFrames, left, right), numFrames);
+
+        for (int i = 0; i < numFrames; ++i) {
+            EXPECT_EQ(left[i], samples[2 * i]);
+            EXPECT_EQ(right[i], samples[2 * i + 1]);
+        }
+    }
+}
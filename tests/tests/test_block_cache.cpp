@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "engine/block_cache.h"
+#include <memory>
+
+using namespace tonewheel;
+
+TEST(core, BlockCache)
+{
+    BlockCache cache(3 * BlockCache::blockSizeInBytes);
+
+    const auto makeBlock = [](int numFrames) {
+        auto block{ std::make_shared<BlockCache::Block>() };
+        block->numFrames = numFrames;
+        return block;
+    };
+
+    EXPECT_EQ(cache.find(1, 0), nullptr);
+
+    cache.insert(1, 0, makeBlock(10));
+    cache.insert(1, 1, makeBlock(11));
+    cache.insert(2, 0, makeBlock(20));
+
+    ASSERT_NE(cache.find(1, 0), nullptr);
+    EXPECT_EQ(cache.find(1, 0)->numFrames, 10);
+
+    // Block (1, 0) has been referenced, (1, 1) should be evicted first
+    cache.insert(3, 0, makeBlock(30));
+
+    EXPECT_NE(cache.find(1, 0), nullptr);
+    EXPECT_EQ(cache.find(1, 1), nullptr);
+    EXPECT_NE(cache.find(3, 0), nullptr);
+
+    // Inserting an already cached block keeps the existing one
+    EXPECT_EQ(cache.insert(3, 0, makeBlock(31))->numFrames, 30);
+
+    const auto stats{ cache.getStats() };
+    EXPECT_EQ(stats.numBlocks, 3u);
+    EXPECT_EQ(stats.hits, 4u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.evictions, 1u);
+
+    cache.setCapacity(0);
+    EXPECT_FALSE(cache.isEnabled());
+    cache.insert(1, 0, makeBlock(10));
+    EXPECT_EQ(cache.find(1, 0), nullptr);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "engine/dsp/delay_line.h"
+#include "engine/core/memory_arena.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace tonewheel;
+
+/** Released blocks are reused by the arena. */
+TEST(core, MemoryArena)
+{
+    core::MemoryArena arena{};
+
+    EXPECT_EQ(core::MemoryArena::getOrder(1), core::MemoryArena::minOrder);
+    EXPECT_EQ(core::MemoryArena::getOrder(1000), 10);
+    EXPECT_EQ(core::MemoryArena::getOrder(1024), 10);
+    EXPECT_EQ(core::MemoryArena::getOrder(1025), 11);
+    EXPECT_EQ(core::MemoryArena::getOrder(core::MemoryArena::getBlockSize(core::MemoryArena::maxOrder) + 1), -1);
+
+    float* a{ arena.acquire(10) };
+    float* b{ arena.acquire(10) };
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(arena.getNumBlocks(), 2);
+
+    arena.release(a, 10);
+    EXPECT_EQ(arena.acquire(10), a);
+    EXPECT_EQ(arena.getNumBlocks(), 2);
+
+    arena.release(a, 10);
+    arena.release(b, 10);
+}
+
+/** Block reads and writes must match the per-sample ones, across the wrap. */
+TEST(dsp, DelayLineBlocks)
+{
+    auto arena{ std::make_shared<core::MemoryArena>() };
+
+    dsp::DelayLine ref{};
+    dsp::DelayLine line{};
+    ref.prepare(arena, 100);
+    line.prepare(arena, 100);
+
+    EXPECT_EQ(line.getLength(), 100);
+    EXPECT_EQ(line.getCapacity(), 128);
+
+    constexpr int blockSize{ 23 };
+    float in[blockSize], delays[blockSize], out[blockSize];
+    int t{ 0 };
+
+    for (int block = 0; block < 40; ++block) {
+        for (int i = 0; i < blockSize; ++i, ++t) {
+            in[i] = std::sin(0.1f * (float)t);
+            delays[i] = 40.0f + 15.0f * std::sin(0.01f * (float)t);
+        }
+
+        line.readBlock(delays, out, blockSize);
+        line.writeBlock(in, blockSize);
+
+        // Read before each write
+        for (int i = 0; i < blockSize; ++i) {
+            EXPECT_FLOAT_EQ(out[i], ref.read(delays[i]));
+            ref.write(in[i]);
+        }
+    }
+}
+
+/** Cubic interpolation is exact on polynomials up to the third order. */
+TEST(dsp, DelayLineCubic)
+{
+    auto arena{ std::make_shared<core::MemoryArena>() };
+
+    dsp::DelayLine line{};
+    line.prepare(arena, 64);
+    line.setInterpolation(dsp::DelayLine::Interpolation::Cubic);
+
+    for (int i = 0; i < 100; ++i)
+        line.write(0.01f * (float)(i * i));
+
+    // The newest sample is i = 99, and the read position moves forward with the frames
+    const float delays[]{ 1.25f, 2.5f, 12.75f, 20.0f, 31.5f };
+    float out[5];
+    line.readBlock(delays, out, 5);
+
+    for (int i = 0; i < 5; ++i) {
+        const float x{ 99.0f - delays[i] + (float)i };
+        EXPECT_NEAR(out[i], 0.01f * x * x, 1e-3f);
+    }
+}
+
+/** All-pass interpolation passes a constant signal through. */
+TEST(dsp, DelayLineAllPass)
+{
+    auto arena{ std::make_shared<core::MemoryArena>() };
+
+    dsp::DelayLine line{};
+    line.prepare(arena, 64);
+    line.setInterpolation(dsp::DelayLine::Interpolation::AllPass);
+
+    constexpr int blockSize{ 16 };
+    float in[blockSize], delays[blockSize], out[blockSize];
+
+    for (int i = 0; i < blockSize; ++i) {
+        in[i] = 0.5f;
+        delays[i] = 10.3f + (float)i;
+    }
+
+    for (int block = 0; block < 20; ++block) {
+        line.writeBlock(in, blockSize);
+        line.readBlock(delays, out, blockSize);
+    }
+
+    for (int i = 0; i < blockSize; ++i)
+        EXPECT_NEAR(out[i], 0.5f, 1e-4f);
+}
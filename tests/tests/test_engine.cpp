@@ -0,0 +1,396 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+#include "engine/engine.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace tonewheel;
+using test::waitForPreload;
+using test::writeConstantWav;
+
+TEST(engine, ScheduledControlChange)
+{
+    Engine engine{};
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 64);
+
+    std::vector<float> left(64);
+    std::vector<float> right(64);
+
+    engine.setCC(0, 1.0f, 10);
+    engine.setCC(1, 1.0f, 40);
+
+    engine.process(left.data(), right.data(), 10);
+    EXPECT_EQ(engine.getCC(0), 0.0f);
+
+    // Offset 10 falls on the first frame of the next block
+    engine.process(left.data(), right.data(), 1);
+    EXPECT_EQ(engine.getCC(0), 1.0f);
+
+    engine.process(left.data(), right.data(), 21);
+    EXPECT_EQ(engine.getCC(1), 0.0f);
+
+    engine.process(left.data(), right.data(), 8);
+    EXPECT_EQ(engine.getCC(1), 0.0f);
+
+    engine.process(left.data(), right.data(), 1);
+    EXPECT_EQ(engine.getCC(1), 1.0f);
+
+    // Immediate change
+    engine.setCC(2, 0.5f);
+    EXPECT_EQ(engine.getCC(2), 0.5f);
+
+    EXPECT_EQ(engine.getStats().numBlocks, 5u);
+}
+
+TEST(engine, ProcessOutputs)
+{
+    Engine engine{ 2 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 32);
+    engine.getAudioBusPool()[1].setOutput(1);
+
+    std::vector<float> buffers(4 * 48, 1.0f);
+    float* outputs[4]{ &buffers[0], &buffers[48], &buffers[96], &buffers[144] };
+
+    // Larger than the frame size, rendered in two parts
+    engine.process(outputs, 4, 48);
+
+    for (float x : buffers)
+        EXPECT_EQ(x, 0.0f);
+
+    const auto stats{ engine.getStats() };
+    EXPECT_EQ(stats.numBlocks, 1u);
+    EXPECT_GE(stats.maxBlockTime, stats.lastBlockTime);
+}
+
+TEST(engine, VoiceStealing)
+{
+    Engine engine{ 1 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 32);
+
+    const int sampleId{ engine.addSample(writeConstantWav("tonewheel_test_stealing.wav", 44100)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(4096);
+    waitForPreload(samplePool);
+
+    auto& bus{ engine.getAudioBusPool()[0] };
+    bus.setPolyphony(2);
+
+    std::vector<float> left(32);
+    std::vector<float> right(32);
+
+    const auto trigger = [&](int key) {
+        Engine::Trigger trig{};
+        trig.sampleId = sampleId;
+        trig.busNumber = 0;
+        trig.key = key;
+        trig.envelope.release = 1.0f;
+        return engine.triggerVoice(trig);
+    };
+
+    const int a{ trigger(60) };
+    const int b{ trigger(62) };
+    engine.process(left.data(), right.data(), 32);
+    EXPECT_EQ(bus.getNumPlayingVoices(), 2);
+
+    const int c{ trigger(64) };
+    engine.process(left.data(), right.data(), 32);
+
+    ASSERT_NE(bus.findVoiceWithId(a), nullptr);
+    EXPECT_TRUE(bus.findVoiceWithId(a)->isStolen());
+    EXPECT_FALSE(bus.findVoiceWithId(b)->isStolen());
+    EXPECT_EQ(bus.getNumPlayingVoices(), 2);
+
+    // The stolen voice fades out quickly
+    for (int i = 0; i < 32; ++i)
+        engine.process(left.data(), right.data(), 32);
+
+    EXPECT_EQ(bus.findVoiceWithId(a), nullptr);
+
+    engine.setVoiceStealing(VoiceStealing::SameKey);
+    const int d{ trigger(64) };
+    engine.process(left.data(), right.data(), 32);
+
+    EXPECT_FALSE(bus.findVoiceWithId(b)->isStolen());
+    EXPECT_TRUE(bus.findVoiceWithId(c)->isStolen());
+    EXPECT_FALSE(bus.findVoiceWithId(d)->isStolen());
+
+    engine.reset();
+}
+
+TEST(engine, VoiceLookup)
+{
+    Engine engine{ 2 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 32);
+
+    const int sampleId{ engine.addSample(writeConstantWav("tonewheel_test_lookup.wav", 44100)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(4096);
+    waitForPreload(samplePool);
+
+    std::vector<float> left(32);
+    std::vector<float> right(32);
+
+    const auto trigger = [&](int key, int bus) {
+        Engine::Trigger trig{};
+        trig.sampleId = sampleId;
+        trig.busNumber = bus;
+        trig.key = key;
+        return engine.triggerVoice(trig);
+    };
+
+    std::vector<int> ids{};
+
+    for (int i = 0; i < 40; ++i)
+        ids.push_back(trigger(60 + i % 2, i % 2));
+
+    engine.process(left.data(), right.data(), 32);
+
+    auto& buses{ engine.getAudioBusPool() };
+
+    for (int id : ids) {
+        ASSERT_NE(buses.findVoiceWithId(id), nullptr);
+        EXPECT_EQ(buses.findVoiceWithId(id)->getTrigger().voiceId, id);
+    }
+
+    int count{ 0 };
+
+    for (auto* voice{ buses.getVoicesForKey(60).first() }; voice != nullptr; voice = voice->nextForKey()) {
+        EXPECT_TRUE(voice->isForKey(60));
+        ++count;
+    }
+
+    EXPECT_EQ(count, 20);
+
+    engine.releaseKey(60, 0.001f);
+
+    for (int i = 0; i < 16; ++i)
+        engine.process(left.data(), right.data(), 32);
+
+    EXPECT_TRUE(buses.getVoicesForKey(60).isEmpty());
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i % 2 == 0)
+            EXPECT_EQ(buses.findVoiceWithId(ids[i]), nullptr);
+        else
+            EXPECT_NE(buses.findVoiceWithId(ids[i]), nullptr);
+    }
+
+    engine.reset();
+    EXPECT_TRUE(buses.getVoicesForKey(61).isEmpty());
+}
+
+TEST(engine, MonoVoice)
+{
+    Engine engine{ 1 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 64);
+
+    // Longer than the preload, so that the voice is streamed as well
+    const int sampleId{ engine.addSample(writeConstantWav("tonewheel_test_mono.wav", 44100, 1)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(256);
+    waitForPreload(samplePool);
+
+    const auto sample{ engine.getSampleById(sampleId) };
+    ASSERT_NE(sample, nullptr);
+    EXPECT_EQ(sample->getNumChannels(), 1);
+
+    Engine::Trigger trig{};
+    trig.sampleId = sampleId;
+    trig.busNumber = 0;
+    trig.tune = 0.75f;
+    const int id{ engine.triggerVoice(trig) };
+
+    std::vector<float> left(64);
+    std::vector<float> right(64);
+
+    for (int block = 0; block < 16; ++block) {
+        engine.process(left.data(), right.data(), 64);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        for (int i = 0; i < 64; ++i)
+            EXPECT_EQ(left[i], right[i]);
+    }
+
+    // Past the envelope attack the output settles at the sample value
+    EXPECT_NEAR(left[63], 0.25f, 1e-3f);
+
+    auto* voice{ engine.getAudioBusPool().findVoiceWithId(id) };
+    ASSERT_NE(voice, nullptr);
+    EXPECT_EQ(voice->getStream()->getNumChannels(), 1);
+
+    engine.reset();
+}
+
+TEST(engine, StreamBufferSizing)
+{
+    Engine engine{ 1 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 64);
+
+    // The streams wait for the worker instead of depending on timing
+    engine.setNonRealtime(true);
+
+    const int sampleId{ engine.addSample(writeConstantWav("tonewheel_test_stream.wav", 44100 * 4)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(1024);
+    waitForPreload(samplePool);
+
+    // Streams of the previous tests may not be recycled yet
+    auto& streamPool{ GlobalEngine::getInstance()->getAudioStreamPool() };
+    streamPool.recycleStreams(true);
+    const int numFreeChunks{ streamPool.getNumFreeChunks() };
+
+    const auto trigger = [&](float tune) {
+        Engine::Trigger trig{};
+        trig.sampleId = sampleId;
+        trig.busNumber = 0;
+        trig.tune = tune;
+        return engine.triggerVoice(trig);
+    };
+
+    const int slow{ trigger(1.0f) };
+    const int fast{ trigger(8.0f) };
+
+    std::vector<float> left(64);
+    std::vector<float> right(64);
+    engine.process(left.data(), right.data(), 64);
+
+    auto& buses{ engine.getAudioBusPool() };
+    ASSERT_NE(buses.findVoiceWithId(slow), nullptr);
+    ASSERT_NE(buses.findVoiceWithId(fast), nullptr);
+
+    const int slowSize{ buses.findVoiceWithId(slow)->getStream()->getBufferSize() };
+    const int fastSize{ buses.findVoiceWithId(fast)->getStream()->getBufferSize() };
+
+    EXPECT_GE(slowSize, MIN_STREAM_BUFFER_CHUNKS * STREAM_BUFFER_CHUNK_SIZE);
+    EXPECT_GT(fastSize, slowSize);
+    EXPECT_EQ(streamPool.getNumFreeChunks(), numFreeChunks - (slowSize + fastSize) / STREAM_BUFFER_CHUNK_SIZE);
+
+    // The fast voice keeps up with its stream
+    const auto underruns{ buses.findVoiceWithId(fast)->getStream()->getNumUnderruns() };
+
+    for (int i = 0; i < 64; ++i)
+        engine.process(left.data(), right.data(), 64);
+
+    auto* voice{ buses.findVoiceWithId(fast) };
+    ASSERT_NE(voice, nullptr);
+    EXPECT_EQ(voice->getStream()->getNumUnderruns(), underruns);
+
+    engine.reset();
+
+    // The chunks are back once the voices are recycled
+    // and the worker is done with their streams.
+    engine.process(left.data(), right.data(), 64);
+    EXPECT_EQ(streamPool.getNumFreeChunks(), numFreeChunks);
+    EXPECT_GT(streamPool.getRefillLatency(), 0.0f);
+}
+
+TEST(engine, ResidentLoop)
+{
+    Engine engine{ 1 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 256);
+
+    // The voices would end past the sample length without the loop
+    const int sampleId{ engine.addSample(writeConstantWav("tonewheel_test_loop.wav", 8000)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(1024);
+    waitForPreload(samplePool);
+
+    auto& loopCache{ GlobalEngine::getInstance()->getLoopCache() };
+
+    const auto trigger = [&]() {
+        Engine::Trigger trig{};
+        trig.sampleId = sampleId;
+        trig.busNumber = 0;
+        trig.loopBegin = 2000;
+        trig.loopEnd = 6000;
+        return engine.triggerVoice(trig);
+    };
+
+    const int a{ trigger() };
+    const int b{ trigger() };
+
+    std::vector<float> left(256);
+    std::vector<float> right(256);
+
+    for (int block = 0; block < 128; ++block) {
+        engine.process(left.data(), right.data(), 256);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    // Both voices share the same decoded loop
+    EXPECT_EQ(loopCache.getNumLoops(), 1u);
+
+    auto& buses{ engine.getAudioBusPool() };
+    ASSERT_NE(buses.findVoiceWithId(a), nullptr);
+    ASSERT_NE(buses.findVoiceWithId(b), nullptr);
+    EXPECT_EQ(buses.findVoiceWithId(a)->getStream()->getNumUnderruns(), 0);
+    EXPECT_GT(left[255], 0.0f);
+
+    engine.reset();
+}
+
+TEST(engine, LoopDecodedInParts)
+{
+    Engine engine{ 1 };
+    engine.prepareToPlay(DEFAULT_SAMPLE_RATE_F, 256);
+
+    constexpr int loopBegin{ 2000 };
+    constexpr int loopEnd{ loopBegin + 16 * CACHE_BLOCK_SIZE };
+    constexpr int loopXfade{ 128 };
+
+    const int loopedId{ engine.addSample(writeConstantWav("tonewheel_test_long_loop.wav", loopEnd + 1000)) };
+    const int streamedId{ engine.addSample(writeConstantWav("tonewheel_test_streamed.wav", 44100 * 10)) };
+    auto& samplePool{ GlobalEngine::getInstance()->getSamplePool() };
+    samplePool.preload(1024);
+    waitForPreload(samplePool);
+
+    const auto loopedSample{ engine.getSampleById(loopedId) };
+    const auto streamedSample{ engine.getSampleById(streamedId) };
+    ASSERT_NE(loopedSample, nullptr);
+    ASSERT_NE(streamedSample, nullptr);
+
+    auto& streamPool{ GlobalEngine::getInstance()->getAudioStreamPool() };
+    auto& loopCache{ GlobalEngine::getInstance()->getLoopCache() };
+    const LoopCache::Key key{ loopedSample->getHash(), loopBegin, loopEnd, loopXfade };
+
+    // Both streams share a worker that is driven by the test
+    core::Worker worker{};
+
+    auto* looped{ streamPool.getStream() };
+    auto* streamed{ streamPool.getStream() };
+    ASSERT_NE(looped, nullptr);
+    ASSERT_NE(streamed, nullptr);
+
+    looped->setLoop(loopBegin, loopEnd, loopXfade);
+    looped->trigger(loopedSample, &worker);
+    streamed->trigger(streamedSample, &worker);
+
+    // Initial fill of both buffers
+    worker.runNextJob();
+    worker.runNextJob();
+
+    std::vector<float> left(STREAM_BUFFER_CHUNK_SIZE * MAX_STREAM_BUFFER_CHUNKS);
+    std::vector<float> right(STREAM_BUFFER_CHUNK_SIZE * MAX_STREAM_BUFFER_CHUNKS);
+    int numRefills{ 0 };
+
+    // The streamed refills are served in between the parts of the loop
+    while (loopCache.find(key) == nullptr && numRefills < 64) {
+        streamed->fillBuffers(left.data(), right.data(), streamed->getBufferSize() / 2);
+        worker.runNextJob();
+        worker.runNextJob();
+        ++numRefills;
+    }
+
+    EXPECT_NE(loopCache.find(key), nullptr);
+    EXPECT_GT(numRefills, 1);
+    EXPECT_EQ(streamed->getNumUnderruns(), 0);
+
+    looped->returnToPool();
+    streamed->returnToPool();
+
+    while (worker.runNextJob())
+        ;
+
+    streamPool.recycleStreams(true);
+}
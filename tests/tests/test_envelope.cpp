@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "engine/dsp/envelope.h"
+#include <vector>
+
+using namespace tonewheel;
+
+namespace {
+
+/** Render an envelope both per sample and per block, releasing it at a given frame. */
+void compareEnvelopes(const dsp::Envelope::Spec& spec, int releaseFrame, int numFrames, int blockSize)
+{
+    dsp::Envelope ref{};
+    dsp::Envelope env{};
+    ref.trigger(spec);
+    env.trigger(spec);
+
+    std::vector<float> out(blockSize);
+
+    for (int pos = 0; pos < numFrames; pos += blockSize) {
+        if (pos == releaseFrame) {
+            ref.release();
+            env.release();
+        }
+
+        env.process(out.data(), blockSize);
+
+        for (int i = 0; i < blockSize; ++i) {
+            const float expected{ ref.getNext() };
+            ASSERT_NEAR(out[i], expected, 1e-5f) << "frame " << pos + i;
+        }
+
+        ASSERT_EQ(env.getState(), ref.getState()) << "frame " << pos;
+    }
+}
+
+} // anonymous namespace
+
+/** Block envelope must match the per-sample one through all the stages. */
+TEST(dsp, EnvelopeBlocks)
+{
+    dsp::Envelope::Spec spec{};
+    spec.attack = 0.01f;
+    spec.decay = 0.05f;
+    spec.sustain = 0.5f;
+    spec.release = 0.1f;
+    spec.sampleRate = 44100.0f;
+
+    for (int blockSize : { 1, 7, 32, 64 }) {
+        const int releaseFrame{ 8000 / blockSize * blockSize };
+        compareEnvelopes(spec, releaseFrame, 16000, blockSize);
+    }
+
+    // Instantaneous stages
+    spec.attack = 0.0f;
+    spec.decay = 0.0f;
+    spec.release = 0.0f;
+    compareEnvelopes(spec, 64, 256, 32);
+
+    // Released during the attack
+    spec.attack = 1.0f;
+    spec.release = 0.02f;
+    compareEnvelopes(spec, 320, 4000, 32);
+}
@@ -101,3 +101,42 @@ TEST(core, List)
         }
     }
 }
+
+/** Test walking a list backwards after inserting items. */
+TEST(core, ListBackwards)
+{
+    Data data[SIZE];
+
+    for (int i = 0; i < SIZE; ++i)
+        data[i].value = i;
+
+    List<Data> list;
+
+    // Odd values from the head
+    for (int i = SIZE - 1; i > 0; i -= 2)
+        list.prepend(&data[i]);
+
+    // Even values after their predecessors
+    for (int i = 2; i < SIZE; i += 2)
+        data[i].appendAfter(&data[i - 1]);
+
+    list.prepend(&data[0]);
+
+    EXPECT_EQ(list.first()->prev(), nullptr);
+    EXPECT_EQ(list.last()->next(), nullptr);
+
+    auto* it{ list.last() };
+    int counter{ SIZE };
+
+    while (it != nullptr) {
+        --counter;
+        EXPECT_EQ(it->value, counter);
+        it = it->prev();
+    }
+
+    EXPECT_EQ(counter, 0);
+
+    // Access by index from the tail
+    for (int i = 0; i < SIZE; ++i)
+        EXPECT_EQ(data[i].value, list[-SIZE + i]->value);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "engine/core/mpmc_queue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace tonewheel;
+
+TEST(core, MPMCQueue)
+{
+    constexpr int numProducers{ 3 };
+    constexpr int numConsumers{ 3 };
+    constexpr int numItems{ 20000 };
+
+    core::MPMCQueue<int, 64> queue;
+
+    // Single thread: capacity and order
+    for (int i = 0; i < 64; ++i)
+        ASSERT_TRUE(queue.send(i));
+
+    EXPECT_FALSE(queue.send(64));
+    EXPECT_EQ(queue.count(), 64u);
+
+    for (int i = 0; i < 64; ++i) {
+        int x{ -1 };
+        ASSERT_TRUE(queue.receive(x));
+        EXPECT_EQ(x, i);
+    }
+
+    int dummy{};
+    EXPECT_FALSE(queue.receive(dummy));
+
+    // Concurrent producers and consumers
+    std::vector<std::atomic<int>> received(numProducers * numItems);
+    std::atomic<int> numReceived{ 0 };
+    std::vector<std::thread> threads{};
+
+    for (int p = 0; p < numProducers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < numItems; ++i) {
+                while (!queue.send(p * numItems + i))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (int c = 0; c < numConsumers; ++c) {
+        threads.emplace_back([&] {
+            while (numReceived < numProducers * numItems) {
+                int x{};
+
+                if (queue.receive(x)) {
+                    ++received[x];
+                    ++numReceived;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    for (const auto& r : received)
+        ASSERT_EQ(r, 1);
+}
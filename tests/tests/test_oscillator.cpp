@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include "engine/dsp/oscillator.h"
+#include <cmath>
+#include <vector>
+
+using namespace tonewheel;
+
+/** Quadrature oscillator must follow the cosine and sine of its phase. */
+TEST(dsp, QuadratureOscillator)
+{
+    constexpr int numFrames{ 100000 };
+    constexpr int blockSize{ 256 };
+    constexpr double increment{ 2.0 * 3.141592653589793 * 1234.5 / 44100.0 };
+    constexpr double phase{ 0.3 };
+
+    dsp::QuadratureOscillator::Spec spec{};
+    spec.increment = (float)increment;
+    dsp::QuadratureOscillator::update(spec);
+
+    dsp::QuadratureOscillator::State state{};
+    dsp::QuadratureOscillator::reset(spec, state, (float)phase);
+
+    std::vector<float> c(blockSize);
+    std::vector<float> s(blockSize);
+
+    // The reference phase uses the same (rounded) increment
+    const double delta{ (double)spec.increment };
+
+    for (int pos = 0; pos < numFrames; pos += blockSize) {
+        dsp::QuadratureOscillator::process(spec, state, c.data(), s.data(), blockSize);
+
+        for (int i = 0; i < blockSize; ++i) {
+            const double a{ phase + delta * (double)(pos + i) };
+            ASSERT_NEAR(c[i], std::cos(a), 1e-3);
+            ASSERT_NEAR(s[i], std::sin(a), 1e-3);
+        }
+    }
+
+    // Renormalized after each block
+    EXPECT_NEAR(state.c * state.c + state.s * state.s, 1.0f, 1e-5f);
+}
+
+/** Phase of a tick-driven oscillator. */
+TEST(dsp, QuadratureOscillatorTick)
+{
+    dsp::QuadratureOscillator::Spec spec{};
+    spec.increment = 0.5f * 3.14159265f;
+    dsp::QuadratureOscillator::update(spec);
+
+    dsp::QuadratureOscillator::State state{};
+    dsp::QuadratureOscillator::reset(spec, state);
+
+    const float expected[][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 0.0f, -1.0f }, { 1.0f, 0.0f } };
+
+    for (const auto& e : expected) {
+        float c, s;
+        dsp::QuadratureOscillator::tick(spec, state, c, s);
+        EXPECT_NEAR(c, e[0], 1e-5f);
+        EXPECT_NEAR(s, e[1], 1e-5f);
+    }
+}
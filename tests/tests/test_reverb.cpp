@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "engine/dsp/reverb.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace tonewheel;
+
+/** Stereo reverb must match a pair of scalar reverbs with the stereo spread. */
+TEST(dsp, StereoReverb)
+{
+    using ReverbL = dsp::Reverb<0>;
+    using ReverbR = dsp::Reverb<dsp::StereoReverb::stereoSpread>;
+
+    constexpr int numFrames{ 8000 };
+
+    std::vector<float> inL(numFrames);
+    std::vector<float> inR(numFrames);
+
+    for (int i = 0; i < numFrames; ++i) {
+        inL[i] = i < 500 ? std::sin(0.05f * (float)i) : 0.0f;
+        inR[i] = i < 700 ? std::cos(0.13f * (float)i) : 0.0f;
+    }
+
+    auto specL{ std::make_unique<ReverbL::Spec>() };
+    auto specR{ std::make_unique<ReverbR::Spec>() };
+    auto stateL{ std::make_unique<ReverbL::State>() };
+    auto stateR{ std::make_unique<ReverbR::State>() };
+
+    specL->roomSize = specR->roomSize = 0.8f;
+    specL->damp = specR->damp = 0.2f;
+    ReverbL::update(*specL);
+    ReverbR::update(*specR);
+    ReverbL::reset(*specL, *stateL);
+    ReverbR::reset(*specR, *stateR);
+
+    std::vector<float> refL(numFrames);
+    std::vector<float> refR(numFrames);
+    ReverbL::process(*specL, *stateL, inL.data(), refL.data(), numFrames);
+    ReverbR::process(*specR, *stateR, inR.data(), refR.data(), numFrames);
+
+    dsp::StereoReverb::Spec spec{};
+    spec.roomSize = 0.8f;
+    spec.damp = 0.2f;
+
+    auto state{ std::make_unique<dsp::StereoReverb::State>() };
+    dsp::StereoReverb::update(spec);
+    dsp::StereoReverb::reset(spec, *state);
+
+    std::vector<float> outL(numFrames);
+    std::vector<float> outR(numFrames);
+
+    // Process in blocks of various sizes
+    for (int pos = 0, n = 1; pos < numFrames; pos += n, n = n % 97 + 13) {
+        n = std::min(n, numFrames - pos);
+        dsp::StereoReverb::process(spec, *state, &inL[pos], &inR[pos], &outL[pos], &outR[pos], n);
+    }
+
+    for (int i = 0; i < numFrames; ++i) {
+        ASSERT_NEAR(outL[i], refL[i], 1e-6f) << "at frame " << i;
+        ASSERT_NEAR(outR[i], refR[i], 1e-6f) << "at frame " << i;
+    }
+}
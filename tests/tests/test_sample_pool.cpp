@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "test_utils.h"
+#include "engine/sample.h"
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace tonewheel;
+using test::waitForPreload;
+
+namespace {
+
+/** Write a stereo 16-bit WAV file, samples counting up. */
+std::string writeWav(const std::string& name, int numFrames)
+{
+    return test::writeWav(name, {}, numFrames,
+                          [](auto& payload, int i, int ch) { test::put16(payload, uint16_t(2 * i + ch)); });
+}
+
+} // anonymous namespace
+
+TEST(sample_pool, ParallelPreload)
+{
+    constexpr int numSamples{ 32 };
+
+    SamplePool pool{};
+    std::vector<Sample::Ptr> samples{};
+
+    for (int i = 0; i < numSamples; ++i)
+        samples.push_back(pool.addSample(writeWav("tonewheel_test_pool_" + std::to_string(i) + ".wav", 1024)));
+
+    // Same file and positions, same sample
+    EXPECT_EQ(pool.addSample(samples[0]->getAudioFile().getPath()), samples[0]);
+
+    pool.markUsed(*samples[numSamples - 1]);
+
+    auto status{ pool.getStatus() };
+    EXPECT_FALSE(status.preloading);
+    EXPECT_EQ(status.totalSamples, numSamples);
+    EXPECT_EQ(status.preloadedSamples, 0);
+
+    pool.preload(512);
+    pool.requestPreload(*samples[numSamples / 2]);
+    EXPECT_GE(pool.getNumPreloadWorkers(), 1);
+
+    waitForPreload(pool);
+
+    status = pool.getStatus();
+    EXPECT_FALSE(status.preloading);
+    EXPECT_EQ(status.preloadedSamples, numSamples);
+    EXPECT_EQ(status.failedSamples, 0);
+    EXPECT_EQ(status.progress, 1.0f);
+    EXPECT_EQ(status.remainingTime, 0.0);
+    EXPECT_GE(status.elapsedTime, 0.0);
+
+    for (const auto& sample : samples) {
+        EXPECT_EQ(sample->getNumPreloadedFrames(), 512);
+        EXPECT_EQ(sample->getPreloadedSamples().getChannelData(0)[1], 2.0f / 32768.0f);
+    }
+
+    // Only the new samples are preloaded by the next pass, failures are reported
+    pool.addSample(writeWav("tonewheel_test_pool_extra.wav", 256));
+    pool.addSample((std::filesystem::temp_directory_path() / "tonewheel_test_pool_missing.wav").string());
+    pool.preload(512);
+    waitForPreload(pool);
+
+    status = pool.getStatus();
+    EXPECT_EQ(status.preloadedSamples, numSamples + 1);
+    EXPECT_EQ(status.totalSamples, numSamples + 2);
+    EXPECT_EQ(status.failedSamples, 1);
+    EXPECT_EQ(status.progress, 1.0f);
+}
+
+TEST(sample_pool, PreloadCache)
+{
+    const auto cacheDir{ std::filesystem::temp_directory_path() / "tonewheel_test_preload_cache" };
+    std::filesystem::remove_all(cacheDir);
+
+    const auto pathA{ writeWav("tonewheel_test_cache_a.wav", 2048) };
+    const auto pathB{ writeWav("tonewheel_test_cache_b.wav", 300) };
+
+    const auto preload = [&](PreloadCache::StorageFormat format, SamplePool::Status& status) {
+        auto pool{ std::make_unique<SamplePool>() };
+        auto& cache{ pool->getPreloadCache() };
+        EXPECT_TRUE(cache.setDirectory(cacheDir.string()).ok());
+        cache.setStorageFormat(format);
+
+        auto a{ pool->addSample(pathA) };
+        auto b{ pool->addSample(pathB) };
+        pool->preload(1024);
+        waitForPreload(*pool);
+        status = pool->getStatus();
+
+        EXPECT_EQ(a->getNumPreloadedFrames(), 1024);
+        EXPECT_EQ(b->getNumPreloadedFrames(), 300);
+        EXPECT_EQ(a->getAudioFile().getSampleRate(), 44100.0f);
+        EXPECT_EQ(a->getAudioFile().getNumChannels(), 2);
+
+        for (int i = 0; i < 1024; ++i) {
+            EXPECT_EQ(a->getPreloadedSamples().getChannelData(0)[i], float(2 * i) / 32768.0f);
+            EXPECT_EQ(a->getPreloadedSamples().getChannelData(1)[i], float(2 * i + 1) / 32768.0f);
+        }
+
+        return cache.getStats();
+    };
+
+    SamplePool::Status status{};
+
+    // Cold start writes the entries
+    auto stats{ preload(PreloadCache::StorageFormat::Float32, status) };
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.writes, 2u);
+
+    // Warm start reads them back
+    stats = preload(PreloadCache::StorageFormat::Float32, status);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.writes, 0u);
+    EXPECT_EQ(status.preloadedSamples, 2);
+
+    // Modified source file invalidates its entry
+    std::filesystem::last_write_time(pathA, std::filesystem::last_write_time(pathA) + std::chrono::seconds(1));
+    stats = preload(PreloadCache::StorageFormat::Int16, status);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.writes, 1u);
+
+    // 16-bit entries are exact for 16-bit sources
+    stats = preload(PreloadCache::StorageFormat::Int16, status);
+    EXPECT_EQ(stats.hits, 2u);
+
+    std::filesystem::remove_all(cacheDir);
+}
+
+TEST(sample_pool, PreloadCacheWriteFailure)
+{
+    const auto cacheDir{ std::filesystem::temp_directory_path() / "tonewheel_test_preload_cache_failure" };
+    const auto path{ writeWav("tonewheel_test_cache_failure.wav", 2048) };
+
+    auto pool{ std::make_unique<SamplePool>() };
+    auto& cache{ pool->getPreloadCache() };
+    ASSERT_TRUE(cache.setDirectory(cacheDir.string()).ok());
+
+    // The entries cannot be written anymore
+    std::filesystem::remove_all(cacheDir);
+
+    auto sample{ pool->addSample(path) };
+    pool->preload(1024);
+    waitForPreload(*pool);
+
+    // The sample is preloaded anyway, and the cache reports the error once
+    EXPECT_EQ(sample->getNumPreloadedFrames(), 1024);
+    EXPECT_FALSE(cache.isEnabled());
+    EXPECT_TRUE(cache.getError().failed());
+
+    ASSERT_TRUE(cache.setDirectory(cacheDir.string()).ok());
+    EXPECT_TRUE(cache.isEnabled());
+    EXPECT_TRUE(cache.getError().ok());
+
+    std::filesystem::remove_all(cacheDir);
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "engine/core/thread_pool.h"
+#include <atomic>
+#include <vector>
+
+using namespace tonewheel;
+
+namespace {
+
+/** Records the completion order of the tasks. */
+struct OrderGraph : public core::ThreadPool::Graph
+{
+    std::vector<std::atomic<int>> completedAt;
+    std::atomic<int> counter{ 0 };
+
+    explicit OrderGraph(int n)
+        : completedAt(n)
+    {
+    }
+
+    void runTask(int index) override
+    {
+        completedAt[index] = counter++;
+    }
+};
+
+} // anonymous namespace
+
+TEST(core, ThreadPool)
+{
+    constexpr int numTasks{ 16 };
+
+    core::ThreadPool pool(3);
+
+    for (int iteration = 0; iteration < 1000; ++iteration) {
+        OrderGraph graph(numTasks);
+
+        // Chain every fourth task: 0 -> 4 -> 8 -> 12, 1 -> 5 -> 9 -> 13, ...
+        pool.reset(numTasks);
+
+        for (int i = 4; i < numTasks; ++i)
+            pool.addDependency(i, i - 4);
+
+        pool.run(graph);
+
+        ASSERT_EQ(graph.counter, numTasks);
+
+        for (int i = 4; i < numTasks; ++i)
+            ASSERT_GT(graph.completedAt[i], graph.completedAt[i - 4]);
+    }
+}
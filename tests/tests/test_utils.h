@@ -0,0 +1,125 @@
+#pragma once
+
+#include "engine/sample.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace test {
+
+inline void put16(std::vector<uint8_t>& v, uint16_t x)
+{
+    v.push_back(uint8_t(x & 0xFF));
+    v.push_back(uint8_t(x >> 8));
+}
+
+inline void put32(std::vector<uint8_t>& v, uint32_t x)
+{
+    put16(v, uint16_t(x & 0xFFFF));
+    put16(v, uint16_t(x >> 16));
+}
+
+inline void put24(std::vector<uint8_t>& v, uint32_t x)
+{
+    v.insert(v.end(), { uint8_t(x), uint8_t(x >> 8), uint8_t(x >> 16) });
+}
+
+inline void putFloat(std::vector<uint8_t>& v, float x)
+{
+    uint32_t bits{};
+    static_assert(sizeof(bits) == sizeof(x));
+    std::memcpy(&bits, &x, sizeof(x));
+    put32(v, bits);
+}
+
+/** WAV file layout. */
+struct WavFormat
+{
+    uint16_t format{ 0x01 };    ///< 0x01 for integer PCM, 0x03 for floating point.
+    int numChannels{ 2 };
+    int bitsPerSample{ 16 };
+    int sampleRate{ 44100 };
+    bool junkChunk{ false };    ///< Insert an odd-sized chunk before the data.
+};
+
+/**
+ * Appends the sample of a frame and channel to the payload,
+ * in the format's sample encoding.
+ */
+using WavGenerator = std::function<void(std::vector<uint8_t>& payload, int frame, int channel)>;
+
+/** Write a WAV file to the temporary directory and return its path. */
+inline std::string writeWav(const std::string& name, const WavFormat& fmt, int numFrames, const WavGenerator& generator)
+{
+    std::vector<uint8_t> payload{};
+
+    for (int i = 0; i < numFrames; ++i) {
+        for (int ch = 0; ch < fmt.numChannels; ++ch)
+            generator(payload, i, ch);
+    }
+
+    const uint16_t blockAlign{ uint16_t(fmt.numChannels * fmt.bitsPerSample / 8) };
+    const uint32_t junkSize{ fmt.junkChunk ? 8u + 4u : 0u };
+
+    std::vector<uint8_t> v{};
+
+    v.insert(v.end(), { 'R', 'I', 'F', 'F' });
+    put32(v, uint32_t(4 + 8 + 16 + junkSize + 8 + payload.size()));
+    v.insert(v.end(), { 'W', 'A', 'V', 'E' });
+
+    v.insert(v.end(), { 'f', 'm', 't', ' ' });
+    put32(v, 16);
+    put16(v, fmt.format);
+    put16(v, uint16_t(fmt.numChannels));
+    put32(v, uint32_t(fmt.sampleRate));
+    put32(v, uint32_t(fmt.sampleRate * blockAlign));
+    put16(v, blockAlign);
+    put16(v, uint16_t(fmt.bitsPerSample));
+
+    if (fmt.junkChunk) {
+        // Odd-sized chunk to be skipped, followed by a pad byte
+        v.insert(v.end(), { 'j', 'u', 'n', 'k' });
+        put32(v, 3);
+        v.insert(v.end(), { 1, 2, 3, 0 });
+    }
+
+    v.insert(v.end(), { 'd', 'a', 't', 'a' });
+    put32(v, uint32_t(payload.size()));
+    v.insert(v.end(), payload.begin(), payload.end());
+
+    const auto path{ (std::filesystem::temp_directory_path() / name).string() };
+
+    if (auto* f{ std::fopen(path.c_str(), "wb") }) {
+        std::fwrite(v.data(), 1, v.size(), f);
+        std::fclose(f);
+    }
+
+    return path;
+}
+
+/** Write a 16-bit WAV file filled with a constant value. */
+inline std::string writeConstantWav(const std::string& name, int numFrames, int numChannels = 2, uint16_t value = 8192)
+{
+    WavFormat fmt{};
+    fmt.numChannels = numChannels;
+
+    return writeWav(name, fmt, numFrames, [value](auto& payload, int, int) { put16(payload, value); });
+}
+
+/** Wait for a samples pool to be done preloading. */
+inline void waitForPreload(const tonewheel::SamplePool& pool,
+                           std::chrono::milliseconds timeout = std::chrono::seconds(10))
+{
+    const auto start{ std::chrono::steady_clock::now() };
+
+    while (pool.isPreloading() && std::chrono::steady_clock::now() - start < timeout)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+} // namespace test